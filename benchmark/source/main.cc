@@ -0,0 +1,693 @@
+// main.cc
+
+#include "spectator_relay.h"
+#include "server_pool.h"
+#include "snapshot.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+   constexpr uint32 input_window = 8;
+   constexpr int64 warmup_ms = 1000;
+
+   // note: a fake client, connects like the game does and then sends an
+   //       input buffer as fast as it can
+   struct bot {
+      bot()
+         : handshake_(uu::MESSAGE_HANDSHAKE_REQUEST, 0, 0)
+         , connected_(false)
+         , input_tick_(0)
+      {
+      }
+
+      udp_socket socket_;
+      uu::message_handshake handshake_;
+      bool connected_;
+      connection connection_;
+      uint32 input_tick_;
+      std::vector<input> inputs_;
+   };
+
+   struct load {
+      std::atomic<bool> running_;
+      packet_pool packets_;
+      ip_address server_;
+      bot *bots_;
+      uint32 bot_count_;
+   };
+
+   void destroy_bots(bot *bots, uint32 count) {
+      for (uint32 index = 0; index < count; index++) {
+         bots[index].socket_.close();
+      }
+      delete[] bots;
+   }
+
+   void drain(bot &b, byte_stream &stream, const gamma::time &now) {
+      ip_address from;
+      while (b.socket_.recv_from(from, stream)) {
+         uu::message_handshake handshake;
+         if (uu::read_handshake(stream, handshake)) {
+            if (handshake.type_ == uu::MESSAGE_HANDSHAKE_CHALLENGE) {
+               b.handshake_ = uu::message_handshake(uu::MESSAGE_HANDSHAKE_RESPONSE, handshake.issued_, handshake.cookie_);
+            }
+         }
+         else if (b.connection_.read_packet(now, stream)) {
+            b.connected_ = true;
+            byte_stream message;
+            while (b.connection_.receive_reliable(message)) {
+            }
+         }
+
+         uint16 sequence = 0;
+         while (b.connection_.poll_ack(sequence)) {
+         }
+         stream.reset();
+      }
+   }
+
+   void run_bots(load *l, uint32 first, uint32 count) {
+      // note: every load thread takes its buffers from the shared pool
+      byte_stream stream;
+      if (!l->packets_.acquire(stream)) {
+         return;
+      }
+
+      while (l->running_) {
+         const gamma::time now = gamma::time::now();
+         for (uint32 index = first; index < first + count; index++) {
+            bot &b = l->bots_[index];
+            stream.reset();
+            drain(b, stream, now);
+
+            // note: the request or response goes out until the session is up
+            if (!b.connected_) {
+               if (uu::write_handshake(stream, b.handshake_)) {
+                  b.socket_.send_to(l->server_, stream);
+               }
+               continue;
+            }
+
+            b.inputs_.push_back(input((index & 1) != 0, (index & 1) == 0, b.input_tick_ % 30 == 0, 16));
+            if (b.inputs_.size() > input_window) {
+               b.inputs_.erase(b.inputs_.begin());
+            }
+            b.input_tick_++;
+
+            uu::message_input_buffer message(b.input_tick_ - (uint32)b.inputs_.size(), b.inputs_);
+            b.connection_.send_unreliable(message);
+
+            stream.reset();
+            if (b.connection_.write_packet(now, stream)) {
+               b.socket_.send_to(l->server_, stream);
+            }
+         }
+      }
+
+      l->packets_.release(stream);
+   }
+
+   bool measure(uint32 workers, uint32 sessions, int64 duration_ms, double &packets_per_second) {
+      uu::server_pool pool;
+      if (!pool.open(0, sessions * 2, workers)) {
+         return false;
+      }
+
+      load l;
+      l.running_ = true;
+      l.server_ = ip_address(127, 0, 0, 1, pool.port());
+      l.bots_ = new bot[sessions];
+      l.bot_count_ = sessions;
+      l.packets_.create(workers);
+      for (uint32 index = 0; index < sessions; index++) {
+         ip_address local;
+         if (!l.bots_[index].socket_.open(local)) {
+            destroy_bots(l.bots_, sessions);
+            return false;
+         }
+
+         uu::message_connection_request request;
+         l.bots_[index].connection_.send_reliable(request);
+      }
+
+      pool.start();
+
+      // note: one load thread per worker so the generator scales with the server
+      std::vector<std::thread> threads;
+      const uint32 per_thread = (sessions + workers - 1) / workers;
+      for (uint32 first = 0; first < sessions; first += per_thread) {
+         const uint32 count = first + per_thread > sessions ? sessions - first : per_thread;
+         threads.emplace_back(run_bots, &l, first, count);
+      }
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(warmup_ms));
+      const uint64 start_packets = pool.packets_received();
+      const gamma::time start = gamma::time::now();
+      std::this_thread::sleep_for(std::chrono::milliseconds(duration_ms));
+      const uint64 end_packets = pool.packets_received();
+      const gamma::time end = gamma::time::now();
+
+      printf("workers %2u: %u sessions, %u matches, ", workers, pool.session_count(), pool.match_count());
+
+      l.running_ = false;
+      for (auto &thread : threads) {
+         thread.join();
+      }
+      pool.close();
+      destroy_bots(l.bots_, sessions);
+
+      const int64 elapsed = end.tick_ - start.tick_;
+      packets_per_second = elapsed > 0 ? (double)(end_packets - start_packets) * 1000.0 / (double)elapsed : 0.0;
+
+      return true;
+   }
+
+   // note: ways the receiving side of a loopback stream is driven. the first
+   //       is how the server used to run, recv_from until dry and a 1 ms nap
+   enum receive_path {
+      RECEIVE_PATH_RECV_FROM,
+      RECEIVE_PATH_POLL,
+      RECEIVE_PATH_IO_URING,
+   };
+
+   constexpr uint32 stream_batch = 16;
+   constexpr uint32 stream_payload = 64;
+
+   int64 steady_ns() {
+      return (int64)std::chrono::duration_cast<std::chrono::nanoseconds>(
+         std::chrono::steady_clock::now().time_since_epoch()).count();
+   }
+
+   struct stream_sender {
+      std::atomic<bool> running_;
+      udp_socket socket_;
+      ip_address target_;
+      uint32 rate_;
+   };
+
+   // note: paced sender, every datagram carries its send time
+   void run_sender(stream_sender *s) {
+      uint8 buffers[stream_batch][stream_payload];
+      byte_stream streams[stream_batch];
+      ip_address addresses[stream_batch];
+      for (uint32 index = 0; index < stream_batch; index++) {
+         memset(buffers[index], 0, stream_payload);
+         addresses[index] = s->target_;
+      }
+
+      const int64 interval = 1000000000ll * stream_batch / s->rate_;
+      int64 next = steady_ns();
+      while (s->running_) {
+         while (steady_ns() < next) {
+            std::this_thread::yield();
+         }
+         next += interval;
+
+         const int64 sent_at = steady_ns();
+         for (uint32 index = 0; index < stream_batch; index++) {
+            memcpy(buffers[index], &sent_at, sizeof(sent_at));
+            streams[index] = byte_stream(stream_payload, buffers[index]);
+            streams[index].at_ = buffers[index] + stream_payload;
+         }
+
+         uint32 sent = 0;
+         s->socket_.send_batch(stream_batch, addresses, streams, sent);
+      }
+   }
+
+   bool measure_receive(receive_path path, uint32 rate, int64 duration_ms,
+                        double &packets_per_second, dynamic_array<int64> &latencies) {
+      udp_socket receiver;
+      ip_address local;
+      if (!receiver.open(local) || !receiver.address_of(local)) {
+         return false;
+      }
+
+      socket_engine engine;
+      if (path != RECEIVE_PATH_RECV_FROM) {
+         engine.open(receiver, path == RECEIVE_PATH_POLL ? socket_engine::OPEN_POLL : socket_engine::OPEN_DEFAULT);
+         if (path == RECEIVE_PATH_IO_URING && engine.backend_ != socket_engine::BACKEND_IO_URING) {
+            receiver.close();
+            return false;
+         }
+      }
+
+      stream_sender sender;
+      sender.running_ = true;
+      sender.target_ = ip_address(127, 0, 0, 1, local.port_);
+      sender.rate_ = rate;
+      ip_address any;
+      if (!sender.socket_.open(any)) {
+         engine.close();
+         receiver.close();
+         return false;
+      }
+
+      uint8 buffers[socket_engine::queue_depth][packet_builder::mtu];
+      byte_stream streams[socket_engine::queue_depth];
+      ip_address addresses[socket_engine::queue_depth];
+
+      latencies.clear();
+      uint64 received = 0;
+      std::thread thread(run_sender, &sender);
+      const int64 start = steady_ns();
+      const int64 end = start + duration_ms * 1000000ll;
+      while (steady_ns() < end) {
+         if (path == RECEIVE_PATH_RECV_FROM) {
+            byte_stream stream(sizeof(buffers[0]), buffers[0]);
+            ip_address from;
+            while (receiver.recv_from(from, stream)) {
+               latencies.push_back(steady_ns() - *(const int64 *)stream.base_);
+               received++;
+               stream.reset();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+         }
+
+         if (!engine.wait(10)) {
+            continue;
+         }
+
+         uint32 count = 0;
+         do {
+            for (uint32 index = 0; index < socket_engine::queue_depth; index++) {
+               streams[index] = byte_stream(sizeof(buffers[index]), buffers[index]);
+            }
+            if (!engine.recv_batch(socket_engine::queue_depth, addresses, streams, count)) {
+               break;
+            }
+
+            const int64 now = steady_ns();
+            for (uint32 index = 0; index < count; index++) {
+               int64 sent_at = 0;
+               memcpy(&sent_at, streams[index].base_, sizeof(sent_at));
+               latencies.push_back(now - sent_at);
+            }
+            received += count;
+         } while (count == socket_engine::queue_depth);
+      }
+      const int64 elapsed = steady_ns() - start;
+
+      sender.running_ = false;
+      thread.join();
+      sender.socket_.close();
+      engine.close();
+      receiver.close();
+
+      packets_per_second = (double)received * 1000000000.0 / (double)elapsed;
+      std::sort(latencies.begin(), latencies.end());
+
+      return true;
+   }
+
+   // note: plays a scripted match and delta encodes every tick against the
+   //       snapshot from ack_delay ticks earlier, like a peer acking with
+   //       that much lag would see it
+   void measure_snapshots(uint32 ticks, uint32 ack_delay, double &average, uint64 &largest) {
+      texture image;
+      uu::sprite_sheet sheet(image);
+      uu::match m;
+      m.reset(sheet, image);
+
+      uu::snapshot_ring sent;
+      uint8 buffer[packet_builder::mtu];
+      uint64 total = 0;
+      largest = 0;
+      for (uint32 tick = 1; tick <= ticks; tick++) {
+         const input left(((tick / 40) & 1) != 0, ((tick / 40) & 1) == 0, tick % 25 == 0, (uint64)uu::match::tick_ms);
+         const input right(((tick / 53) & 1) == 0, ((tick / 53) & 1) != 0, tick % 31 == 0, (uint64)uu::match::tick_ms);
+         m.step(left, right);
+
+         uu::snapshot current;
+         current.capture(m, tick);
+         uu::message_snapshot message(sent, current, tick > ack_delay ? tick - ack_delay : 0);
+         byte_stream stream(sizeof(buffer), buffer);
+         bit_writer writer(stream);
+         if (!message.serialize(writer) || !writer.flush()) {
+            continue;
+         }
+         sent.push(current);
+
+         total += stream.length();
+         if (largest < stream.length()) {
+            largest = stream.length();
+         }
+      }
+
+      average = ticks > 0 ? (double)total / (double)ticks : 0.0;
+   }
+
+   // note: the same scripted match stepped like the server does, every
+   //       bullet checked against the world rewind ticks back
+   double measure_rewind(uint32 ticks, uint32 rewind) {
+      texture image;
+      uu::sprite_sheet sheet(image);
+      uu::match m;
+      m.reset(sheet, image);
+      uu::collider_history history;
+
+      const gamma::time start = gamma::time::now();
+      for (uint32 tick = 0; tick < ticks; tick++) {
+         input left(((tick / 40) & 1) != 0, ((tick / 40) & 1) == 0, tick % 25 == 0, (uint64)uu::match::tick_ms);
+         input right(((tick / 53) & 1) == 0, ((tick / 53) & 1) != 0, tick % 31 == 0, (uint64)uu::match::tick_ms);
+         left.rewind_ = (uint8)rewind;
+         right.rewind_ = (uint8)rewind;
+         history.step(m, tick, left, right);
+      }
+      const gamma::time duration = gamma::time::now() - start;
+
+      return ticks > 0 ? duration.as_milliseconds() * 1000.0 / (double)ticks : 0.0;
+   }
+
+   // note: a spectator on loopback. only every decode_every-th one keeps
+   //       keyframes and decodes, the rest count what reaches them
+   struct viewer {
+      viewer()
+         : keyframes_(nullptr)
+         , received_(0)
+         , decoded_(0)
+         , undecodable_(0)
+      {
+      }
+
+      udp_socket socket_;
+      uu::spectator_link link_;
+      uu::snapshot_ring *keyframes_;
+      uint64 received_;
+      uint64 decoded_;
+      uint64 undecodable_;
+   };
+
+   constexpr uint32 decode_every = 64;
+   constexpr int64 spectator_warmup_ms = 2000;
+   constexpr int64 spectator_join_timeout_ms = 15000;
+
+   // note: spectators join in waves, all at once would only overflow the
+   //       receive buffer of the match server and take longer
+   constexpr uint32 join_wave = 250;
+   constexpr int64 join_wave_ms = 25;
+
+   // note: raw handler, message_snapshot needs the ring to be constructed
+   uu::dispatch_result receive_snapshot(viewer &v, bit_reader &reader) {
+      uu::message_snapshot message(*v.keyframes_);
+      if (!message.serialize(reader)) {
+         v.undecodable_++;
+         return uu::DISPATCH_MALFORMED;
+      }
+
+      // note: the feed sends keyframes as deltas against the empty snapshot
+      if (message.baseline_age_ == 0) {
+         v.keyframes_->push(message.snapshot_);
+      }
+      v.decoded_++;
+      return uu::DISPATCH_CONTINUE;
+   }
+
+   struct audience {
+      std::atomic<bool> running_;
+      uu::server server_;
+      udp_socket players_[uu::MATCH_SIDE_COUNT];
+      uint32 sessions_[uu::MATCH_SIDE_COUNT];
+      dynamic_array<uu::spectator_relay *> relays_;
+      viewer *viewers_;
+      uint32 viewer_count_;
+      std::atomic<uint32> joined_;
+      uu::message_dispatcher<viewer> dispatcher_;
+   };
+
+   // note: the match runs on scripted inputs, the players never send
+   void run_match(audience *a) {
+      uu::server &s = a->server_;
+      uint32 frame = 0;
+      while (a->running_) {
+         const gamma::time now = gamma::time::now();
+         for (uint32 side = 0; side < uu::MATCH_SIDE_COUNT; side++) {
+            uu::session &player = s.sessions_[a->sessions_[side]];
+            player.last_received_ = now.tick_;
+            if (player.match_ == uu::invalid_index) {
+               continue;
+            }
+
+            uu::match_slot &slot = s.matches_[player.match_];
+            std::vector<input> &pending = slot.pending_[side];
+            while (pending.size() < 2) {
+               const uint32 tick = frame + (uint32)pending.size();
+               pending.push_back(input(((tick / (40 + side * 13)) & 1) != 0, ((tick / (40 + side * 13)) & 1) == 0,
+                                       tick % (25 + side * 6) == 0, (uint64)uu::match::tick_ms));
+            }
+         }
+         frame++;
+
+         s.update(now);
+         s.wait(gamma::time::now());
+      }
+   }
+
+   void run_relays(audience *a) {
+      while (a->running_) {
+         const gamma::time now = gamma::time::now();
+         for (auto relay : a->relays_) {
+            relay->update(now);
+         }
+         std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+   }
+
+   void run_viewers(audience *a) {
+      uint8 buffer[packet_builder::mtu];
+      while (a->running_) {
+         const gamma::time now = gamma::time::now();
+         const uint32 joined = a->joined_;
+         for (uint32 index = 0; index < joined; index++) {
+            viewer &v = a->viewers_[index];
+            v.link_.update(v.socket_, now);
+
+            byte_stream stream(sizeof(buffer), buffer);
+            ip_address from;
+            while (v.socket_.recv_from(from, stream)) {
+               if (!v.link_.receive(v.socket_, stream, now)) {
+                  v.received_++;
+                  if (v.keyframes_) {
+                     a->dispatcher_.dispatch(v, stream);
+                  }
+               }
+               stream.reset();
+            }
+         }
+         std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+   }
+
+   // note: one match streamed to count spectators, straight from the match
+   //       server or through relay_count relays below it. reports what the
+   //       spectators received against what one of them should have
+   bool measure_spectators(uint32 count, uint32 relay_count, int64 duration_ms) {
+      audience a;
+      a.running_ = true;
+      a.viewers_ = nullptr;
+      a.viewer_count_ = 0;
+      a.joined_ = 0;
+      a.dispatcher_.set(uu::MESSAGE_SNAPSHOT, &receive_snapshot);
+
+      if (!a.server_.open(0, 2, 0)) {
+         return false;
+      }
+      ip_address root;
+      a.server_.socket_.address_of(root);
+      root = ip_address(127, 0, 0, 1, root.port_);
+
+      const gamma::time start = gamma::time::now();
+      for (uint32 side = 0; side < uu::MATCH_SIDE_COUNT; side++) {
+         ip_address local;
+         a.players_[side].open(local);
+         a.players_[side].address_of(local);
+         a.sessions_[side] = a.server_.create_session(ip_address(127, 0, 0, 1, local.port_), start);
+      }
+      a.server_.start_match(a.sessions_[uu::MATCH_SIDE_LEFT], a.sessions_[uu::MATCH_SIDE_RIGHT]);
+
+      bool result = true;
+      dynamic_array<ip_address> upstreams;
+      for (uint32 index = 0; index < relay_count && result; index++) {
+         uu::spectator_relay *relay = new uu::spectator_relay;
+         ip_address local;
+         result = relay->open(0, root, uu::invalid_index, uu::server::max_spectators) && relay->socket_.address_of(local);
+         a.relays_.push_back(relay);
+         upstreams.push_back(ip_address(127, 0, 0, 1, local.port_));
+      }
+      if (upstreams.empty()) {
+         upstreams.push_back(root);
+      }
+
+      a.viewers_ = new viewer[count];
+      a.viewer_count_ = count;
+      for (uint32 index = 0; index < count && result; index++) {
+         viewer &v = a.viewers_[index];
+         ip_address local;
+         result = v.socket_.open(local);
+         v.link_.reset(upstreams[index % upstreams.size()], uu::invalid_index);
+         if (index % decode_every == 0) {
+            v.keyframes_ = new uu::snapshot_ring;
+         }
+      }
+
+      if (result) {
+         std::thread match_thread(run_match, &a);
+         std::thread relay_thread(run_relays, &a);
+         std::thread viewer_thread(run_viewers, &a);
+
+         while (a.joined_ < count) {
+            a.joined_ = a.joined_ + join_wave < count ? a.joined_ + join_wave : count;
+            std::this_thread::sleep_for(std::chrono::milliseconds(join_wave_ms));
+         }
+
+         // note: wait for everyone to be served before measuring
+         const gamma::time joining = gamma::time::now();
+         uint32 served = 0;
+         while (served < count && gamma::time::now().tick_ - joining.tick_ < spectator_join_timeout_ms) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            served = 0;
+            for (uint32 index = 0; index < count; index++) {
+               served += a.viewers_[index].received_ > 0 ? 1 : 0;
+            }
+         }
+         std::this_thread::sleep_for(std::chrono::milliseconds(spectator_warmup_ms));
+
+         uint64 start_received = 0;
+         for (uint32 index = 0; index < count; index++) {
+            start_received += a.viewers_[index].received_;
+         }
+         socket_stats::snapshot start_stats;
+         a.server_.socket_.stats_.read(start_stats);
+         const gamma::time begin = gamma::time::now();
+
+         std::this_thread::sleep_for(std::chrono::milliseconds(duration_ms));
+
+         uint64 received = 0, decoded = 0, undecodable = 0;
+         for (uint32 index = 0; index < count; index++) {
+            const viewer &v = a.viewers_[index];
+            received += v.received_;
+            decoded += v.decoded_;
+            undecodable += v.undecodable_;
+         }
+         received -= start_received;
+         socket_stats::snapshot end_stats;
+         a.server_.socket_.stats_.read(end_stats);
+         const int64 elapsed = gamma::time::now().tick_ - begin.tick_;
+
+         a.running_ = false;
+         match_thread.join();
+         relay_thread.join();
+         viewer_thread.join();
+
+         // note: the match server sends one snapshot per tick and spectator
+         const double expected = (double)count * (double)elapsed / (double)uu::server::tick_ms;
+         printf("%5u spectators, %u relays: %u served in %lld ms, %.0f snapshots/s delivered, %.1f%% of ticks, %.0f datagrams/s out of the match server, %llu decoded, %llu undecodable\n",
+                count, relay_count, served, (long long)(begin.tick_ - joining.tick_ - spectator_warmup_ms),
+                (double)received * 1000.0 / (double)elapsed,
+                expected > 0.0 ? 100.0 * (double)received / expected : 0.0,
+                (double)(end_stats.packets_out_ - start_stats.packets_out_) * 1000.0 / (double)elapsed,
+                (unsigned long long)decoded, (unsigned long long)undecodable);
+      }
+
+      for (uint32 index = 0; index < count; index++) {
+         a.viewers_[index].socket_.close();
+         delete a.viewers_[index].keyframes_;
+      }
+      delete[] a.viewers_;
+      for (auto relay : a.relays_) {
+         delete relay;
+      }
+      for (auto &player : a.players_) {
+         player.close();
+      }
+      a.server_.close();
+
+      return result;
+   }
+
+   int64 percentile_us(const dynamic_array<int64> &sorted, double fraction) {
+      if (sorted.empty()) {
+         return 0;
+      }
+      const size_t index = (size_t)(fraction * (double)(sorted.size() - 1));
+      return sorted[index] / 1000;
+   }
+} // !anon
+
+// note: measures how many datagrams per second the match server works
+//       through with 1, 2, 4, ... workers sharing one port, then compares
+//       the receive paths on a paced loopback stream, reports the size
+//       of delta compressed snapshots and streams a match to spectators,
+//       directly and through relays
+int main(int argc, char **argv) {
+   const uint32 hardware = std::thread::hardware_concurrency();
+   const uint32 max_workers = argc > 1 ? (uint32)atoi(argv[1]) : (hardware > 1 ? hardware / 2 : 1);
+   const uint32 sessions = argc > 2 ? (uint32)atoi(argv[2]) : 256;
+   const int64 duration_ms = argc > 3 ? (int64)atoi(argv[3]) * 1000 : 5000;
+   const uint32 rate = argc > 4 ? (uint32)atoi(argv[4]) : 50000;
+
+   if (!network::init()) {
+      fprintf(stderr, "could not initialize networking\n");
+      return -1;
+   }
+
+   printf("%u hardware threads, %u sessions, %lld ms per run\n", hardware, sessions, (long long)duration_ms);
+
+   double baseline = 0.0;
+   for (uint32 workers = 1; workers <= max_workers; workers *= 2) {
+      double packets_per_second = 0.0;
+      if (!measure(workers, sessions, duration_ms, packets_per_second)) {
+         auto errcode = network::error::get_error();
+         fprintf(stderr, "could not run with %u workers: %s\n", workers, network::error::as_string(errcode));
+         break;
+      }
+
+      if (workers == 1) {
+         baseline = packets_per_second;
+      }
+      printf("%.0f packets/s, %.2fx\n", packets_per_second, baseline > 0.0 ? packets_per_second / baseline : 0.0);
+   }
+
+   printf("receive paths, %u packets/s offered\n", rate);
+   const char *path_names[] = { "recv_from + 1 ms sleep", "socket_engine poll", "socket_engine io_uring" };
+   for (uint32 path = RECEIVE_PATH_RECV_FROM; path <= RECEIVE_PATH_IO_URING; path++) {
+      double packets_per_second = 0.0;
+      dynamic_array<int64> latencies;
+      if (!measure_receive((receive_path)path, rate, duration_ms, packets_per_second, latencies)) {
+         printf("%-24s: unavailable\n", path_names[path]);
+         continue;
+      }
+
+      printf("%-24s: %.0f packets/s, p50 %lld us, p99 %lld us, p99.9 %lld us\n", path_names[path], packets_per_second,
+             (long long)percentile_us(latencies, 0.5), (long long)percentile_us(latencies, 0.99),
+             (long long)percentile_us(latencies, 0.999));
+   }
+
+   double average = 0.0;
+   uint64 largest = 0;
+   measure_snapshots(4000, 6, average, largest);
+   printf("snapshot deltas, 6 ticks ack delay: %.1f bytes average, %llu bytes largest\n", average, (unsigned long long)largest);
+
+   const double current_us = measure_rewind(20000, 0);
+   const double rewound_us = measure_rewind(20000, 8);
+   printf("lag compensation, 8 ticks rewind: %.2f us per step, %.2f us without, %u bytes of history per match\n",
+          rewound_us, current_us, (uint32)sizeof(uu::collider_history));
+
+   const uint32 spectators = argc > 5 ? (uint32)atoi(argv[5]) : 10000;
+   const uint32 relay_counts[] = { 0, 4 };
+   for (uint32 relays : relay_counts) {
+      if (!measure_spectators(spectators, relays, duration_ms)) {
+         auto errcode = network::error::get_error();
+         fprintf(stderr, "could not stream to %u spectators: %s\n", spectators, network::error::as_string(errcode));
+      }
+   }
+
+   network::shut();
+
+   return 0;
+}
@@ -6,6 +6,7 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <atomic>
 #include <assert.h>
 
 namespace gamma {
@@ -26,6 +27,12 @@ namespace gamma {
    template <typename K, typename V>
    using hashmap = std::unordered_map<K, V>;
 
+   // note: element count of a fixed size array, _countof is msvc only
+   template <typename T, size_t N>
+   constexpr uint32 countof(const T (&)[N]) {
+      return (uint32)N;
+   }
+
    struct vector2 {
       vector2();
       vector2(float x, float y);
@@ -49,6 +56,15 @@ namespace gamma {
       float range(float min, float max);
    } // !random
 
+   namespace hash {
+      // note: siphash-2-4, a keyed hash whose output can be shown to peers
+      //       without them learning enough to forge another one
+      uint64 siphash(const uint64 (&key)[2], const void *data, uint64 size);
+
+      // note: fresh key from the system entropy source
+      void random_key(uint64 (&key)[2]);
+   } // !hash
+
    struct rectangle {
       rectangle();
       rectangle(float x, float y, float width, float height);
@@ -211,6 +227,68 @@ namespace gamma {
       } // !error
    } // !network
 
+   // note: telemetry counters have a single writer, the thread that owns the
+   //       socket or connection, and any number of readers. a relaxed load
+   //       and store costs the writer no more than a plain increment
+   inline void telemetry_add(std::atomic<uint64> &counter, const uint64 value) {
+      counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+   }
+
+   // note: power of two buckets, bucket 0 counts zero and bucket n the
+   //       values in [2^(n-1), 2^n), the last bucket everything above
+   struct histogram {
+      static constexpr uint32 bucket_count = 16;
+
+      struct snapshot {
+         uint64 count() const;
+
+         // note: upper bound of the bucket the fraction of samples falls in
+         int64 percentile(double fraction) const;
+
+         uint64 buckets_[bucket_count];
+      };
+
+      histogram();
+      histogram(const histogram &) = delete;
+      histogram &operator=(const histogram &) = delete;
+
+      void reset();
+      void record(int64 value);
+      void read(snapshot &result) const;
+
+      std::atomic<uint64> buckets_[bucket_count];
+   };
+
+   // note: traffic of one socket. would block is the normal end of a
+   //       non blocking receive and counted apart from real errors
+   struct socket_stats {
+      struct snapshot {
+         uint64 packets_in_;
+         uint64 bytes_in_;
+         uint64 packets_out_;
+         uint64 bytes_out_;
+         uint64 would_block_;
+         uint64 errors_[NETERR_UNKNOWN + 1];
+      };
+
+      socket_stats();
+      socket_stats(const socket_stats &) = delete;
+      socket_stats &operator=(const socket_stats &) = delete;
+
+      void reset();
+      void on_received(uint64 bytes);
+      void on_sent(uint64 bytes);
+      void on_error(network_error_code code);
+      void read(snapshot &result) const;
+
+      std::atomic<uint64> packets_in_;
+      std::atomic<uint64> bytes_in_;
+      std::atomic<uint64> packets_out_;
+      std::atomic<uint64> bytes_out_;
+      std::atomic<uint64> would_block_;
+      std::atomic<uint64> errors_[NETERR_UNKNOWN + 1];
+   };
+
    struct ip_address {
       static bool local_addresses(dynamic_array<ip_address> &addresses);
       static bool lookup(const string &dns, dynamic_array<ip_address> &addresses);
@@ -229,23 +307,54 @@ namespace gamma {
       uint16 port_;
    };
 
+   namespace network {
+      // note: socket index a peer is routed to within a reuse port group of
+      //       `count` sockets, matches the program installed by
+      //       udp_socket::attach_reuse_port_program
+      uint32 reuse_port_index(const ip_address &address, const uint32 count);
+   } // !network
+
    struct byte_stream;
    struct udp_socket {
       udp_socket();
       ~udp_socket() = default;
 
+      enum open_flags {
+         OPEN_DEFAULT = 0,
+         // note: lets several sockets, one per worker thread, bind the same
+         //       port. not available on windows, open fails instead
+         OPEN_REUSE_PORT = 1,
+      };
+
       bool is_valid() const;
       void close();
-      bool open(ip_address &addr);
+      bool open(ip_address &addr, const uint32 flags = OPEN_DEFAULT);
+
+      // note: linux only. pins every peer of the reuse port group this socket
+      //       belongs to onto socket network::reuse_port_index(peer, count),
+      //       sockets are indexed in the order they were bound
+      bool attach_reuse_port_program(const uint32 count);
 
       bool send_to(const ip_address &address, byte_stream &stream);
       bool recv_from(ip_address &address, byte_stream &stream);
       bool address_of(ip_address &address);
 
+      // note: batched variants, on linux backed by sendmmsg/recvmmsg.
+      //       recv_batch returns true if at least one datagram was received,
+      //       `received` holds how many of the streams/addresses were filled in.
+      bool send_batch(const uint32 count, const ip_address *addresses, byte_stream *streams, uint32 &sent);
+      bool recv_batch(const uint32 count, ip_address *addresses, byte_stream *streams, uint32 &received);
+
+      // note: one datagram to many peers, every message of the sendmmsg
+      //       batch points at the same buffer so it is never copied per peer
+      bool send_fanout(const uint32 count, const ip_address *addresses, const byte_stream &stream, uint32 &sent);
+
       uint32 handle_;
+      socket_stats stats_;
    };
 
    struct byte_stream {
+      byte_stream();
       byte_stream(uint64 capacity, uint8 *base);
       ~byte_stream() = default;
 
@@ -258,6 +367,16 @@ namespace gamma {
       uint8 *at_;
    };
 
+   // note: number of bits needed to represent every value in [0, range]
+   constexpr uint32 bits_required(const uint64 range) {
+      return range == 0 ? 0 : 1 + bits_required(range >> 1);
+   }
+
+   // note: number of bits needed for a float in [min, max] quantized to resolution
+   constexpr uint32 bits_required(const float min, const float max, const float resolution) {
+      return bits_required((uint64)((max - min) / resolution + 0.5f));
+   }
+
    struct byte_stream_writer {
       byte_stream_writer(byte_stream &stream);
       ~byte_stream_writer() = default;
@@ -269,6 +388,18 @@ namespace gamma {
       bool serialize(uint8 value);
       bool serialize(const uint32 count, const uint8 *values);
 
+      // note: byte streams round every bit count up to a whole word
+      bool serialize_bits(uint32 value, const uint32 bits);
+      bool serialize_bool(bool value);
+      bool serialize_float(float value, const float min, const float max, const float resolution);
+      bool serialize_varint(uint32 value);
+
+      template <typename T>
+      bool serialize_int(T value, const int64 min, const int64 max) {
+         assert(min < max && (int64)value >= min && (int64)value <= max);
+         return serialize_bits((uint32)((int64)value - min), bits_required((uint64)(max - min)));
+      }
+
       byte_stream &stream_;
    };
 
@@ -283,10 +414,628 @@ namespace gamma {
       bool serialize(uint8 &value);
       bool serialize(const uint32 count, uint8 *values);
 
+      bool serialize_bits(uint32 &value, const uint32 bits);
+      bool serialize_bool(bool &value);
+      bool serialize_float(float &value, const float min, const float max, const float resolution);
+      bool serialize_varint(uint32 &value);
+
+      template <typename T>
+      bool serialize_int(T &value, const int64 min, const int64 max) {
+         uint32 bits_value = 0;
+         if (!serialize_bits(bits_value, bits_required((uint64)(max - min)))) {
+            return false;
+         }
+
+         const int64 result = min + (int64)bits_value;
+         if (result > max) {
+            return false;
+         }
+
+         value = (T)result;
+         return true;
+      }
+
+      bool peek(uint8 &value) const;
+      bool is_at_end() const;
+
       byte_stream &stream_;
       uint8 *cursor_;
    };
 
+   // note: bit packed counterpart of byte_stream_writer, plugs into the same
+   //       `template <typename S> bool serialize(S &)` message methods.
+   //       bits are emitted least significant first, call flush before sending.
+   struct bit_writer {
+      bit_writer(byte_stream &stream);
+      ~bit_writer() = default;
+
+      bool serialize(float value);
+      bool serialize(uint64 value);
+      bool serialize(uint32 value);
+      bool serialize(uint16 value);
+      bool serialize(uint8 value);
+      bool serialize(const uint32 count, const uint8 *values);
+
+      bool serialize_bits(uint32 value, const uint32 bits);
+      bool serialize_bool(bool value);
+      bool serialize_float(float value, const float min, const float max, const float resolution);
+      bool serialize_varint(uint32 value);
+
+      template <typename T>
+      bool serialize_int(T value, const int64 min, const int64 max) {
+         assert(min < max && (int64)value >= min && (int64)value <= max);
+         return serialize_bits((uint32)((int64)value - min), bits_required((uint64)(max - min)));
+      }
+
+      bool flush();
+      void reset();
+      uint64 bits_written() const;
+
+      byte_stream &stream_;
+      uint64 scratch_;
+      uint32 scratch_bits_;
+   };
+
+   struct bit_reader {
+      bit_reader(byte_stream &stream);
+      ~bit_reader() = default;
+
+      bool serialize(float &value);
+      bool serialize(uint64 &value);
+      bool serialize(uint32 &value);
+      bool serialize(uint16 &value);
+      bool serialize(uint8 &value);
+      bool serialize(const uint32 count, uint8 *values);
+
+      bool serialize_bits(uint32 &value, const uint32 bits);
+      bool serialize_bool(bool &value);
+      bool serialize_float(float &value, const float min, const float max, const float resolution);
+      bool serialize_varint(uint32 &value);
+
+      template <typename T>
+      bool serialize_int(T &value, const int64 min, const int64 max) {
+         uint32 bits_value = 0;
+         if (!serialize_bits(bits_value, bits_required((uint64)(max - min)))) {
+            return false;
+         }
+
+         const int64 result = min + (int64)bits_value;
+         if (result > max) {
+            return false;
+         }
+
+         value = (T)result;
+         return true;
+      }
+
+      bool peek(uint8 &value) const;
+      bool is_at_end() const;
+      uint64 bits_remaining() const;
+
+      byte_stream &stream_;
+      uint8 *cursor_;
+      uint64 scratch_;
+      uint32 scratch_bits_;
+   };
+
+   // note: coalesces every message queued for one peer during a tick
+   //       into a single mtu sized datagram, sent on flush
+   struct packet_builder {
+      static constexpr uint32 mtu = 1400;
+
+      packet_builder();
+      packet_builder(const packet_builder &) = delete;
+      packet_builder &operator=(const packet_builder &) = delete;
+
+      template <typename T>
+      bool push(T &message) {
+         uint8 *mark = stream_.at_;
+         const uint64 scratch = writer_.scratch_;
+         const uint32 scratch_bits = writer_.scratch_bits_;
+         if (!message.serialize(writer_)) {
+            // note: message did not fit, drop the partial write
+            stream_.at_ = mark;
+            writer_.scratch_ = scratch;
+            writer_.scratch_bits_ = scratch_bits;
+            return false;
+         }
+
+         count_++;
+         return true;
+      }
+
+      bool is_empty() const;
+      void reset();
+      bool flush(udp_socket &socket, const ip_address &address);
+
+      uint32 count_;
+      uint8 buffer_[mtu];
+      byte_stream stream_;
+      bit_writer writer_;
+   };
+
+   // note: compile time description of a message layout. every field
+   //       knows its worst case size in bits and moves one member through
+   //       any of the serializers, so a single field list drives reading
+   //       and writing alike. a schema is a field itself and can be nested,
+   //       fields name the class that declares the member
+   template <typename M, typename T, T M::*Member>
+   struct schema_value {
+      static constexpr uint32 max_bits = sizeof(T) * 8;
+
+      template <typename S>
+      static bool serialize(S &stream, M &message) {
+         return stream.serialize(message.*Member);
+      }
+   };
+
+   template <typename M, typename T, T M::*Member, int64 Min, int64 Max>
+   struct schema_int {
+      static_assert(Min < Max, "Empty integer range");
+      static constexpr uint32 max_bits = bits_required((uint64)(Max - Min));
+
+      template <typename S>
+      static bool serialize(S &stream, M &message) {
+         return stream.serialize_int(message.*Member, Min, Max);
+      }
+   };
+
+   template <typename M, uint32 M::*Member>
+   struct schema_varint {
+      static constexpr uint32 max_bits = 40;
+
+      template <typename S>
+      static bool serialize(S &stream, M &message) {
+         return stream.serialize_varint(message.*Member);
+      }
+   };
+
+   template <typename... Fields>
+   struct message_schema;
+
+   template <>
+   struct message_schema<> {
+      static constexpr uint32 max_bits = 0;
+
+      template <typename S, typename M>
+      static bool serialize(S &, M &) {
+         return true;
+      }
+   };
+
+   template <typename Field, typename... Rest>
+   struct message_schema<Field, Rest...> {
+      static constexpr uint32 max_bits = Field::max_bits + message_schema<Rest...>::max_bits;
+      static_assert(max_bits <= packet_builder::mtu * 8, "A message must fit in a single datagram");
+
+      template <typename S, typename M>
+      static bool serialize(S &stream, M &message) {
+         return Field::serialize(stream, message) && message_schema<Rest...>::serialize(stream, message);
+      }
+   };
+
+   // note: fixed set of mtu sized packet buffers on their own cache lines,
+   //       handed out as byte_streams. nothing is cleared between uses, a
+   //       stream only ever reads back what was written into it. the free
+   //       list is a lock free stack with a tagged head, so a buffer filled
+   //       on a network thread can be released by the game thread after use
+   struct packet_pool {
+      static constexpr uint32 cache_line = 64;
+      static constexpr uint32 buffer_size = (packet_builder::mtu + cache_line - 1) / cache_line * cache_line;
+      static constexpr uint32 invalid_index = ~0u;
+
+      packet_pool();
+      ~packet_pool();
+      packet_pool(const packet_pool &) = delete;
+      packet_pool &operator=(const packet_pool &) = delete;
+
+      bool is_valid() const;
+      bool create(uint32 count);
+      void destroy();
+
+      // note: the stream stays valid until it is released, exactly once
+      bool acquire(byte_stream &stream);
+      void release(byte_stream &stream);
+      uint32 available() const;
+
+      uint8 *memory_;
+      uint8 *base_;
+      std::atomic<uint32> *next_;
+      uint32 count_;
+      std::atomic<uint64> head_;
+      std::atomic<uint32> available_;
+   };
+
+   // note: completion driven front end for a udp_socket. on linux it runs
+   //       on io_uring, one multishot recvmsg keeps a ring of provided
+   //       buffers filled for as long as the engine is open and a batch of
+   //       sends is a single submission. elsewhere, or when the kernel
+   //       refuses the ring, it falls back to poll and the socket's own
+   //       batch calls. wait blocks until datagrams are ready. received
+   //       streams may point into the engine's buffers, they stay valid
+   //       until the next recv_batch
+   struct socket_engine {
+      static constexpr uint32 buffer_count = 256;
+      static constexpr uint32 buffer_size = 2048;
+      static constexpr uint32 queue_depth = 128;
+
+      enum open_flags {
+         OPEN_DEFAULT = 0,
+         // note: skip io_uring even where it is available
+         OPEN_POLL = 1,
+      };
+
+      enum backend {
+         BACKEND_NONE,
+         BACKEND_POLL,
+         BACKEND_IO_URING,
+      };
+
+      struct ring;
+
+      socket_engine();
+      ~socket_engine();
+      socket_engine(const socket_engine &) = delete;
+      socket_engine &operator=(const socket_engine &) = delete;
+
+      bool is_valid() const;
+      bool open(udp_socket &socket, const uint32 flags = OPEN_DEFAULT);
+      void close();
+      const char *backend_name() const;
+
+      bool wait(int64 timeout_ms);
+      bool send_batch(const uint32 count, const ip_address *addresses, byte_stream *streams, uint32 &sent);
+      bool recv_batch(const uint32 count, ip_address *addresses, byte_stream *streams, uint32 &received);
+
+      udp_socket *socket_;
+      backend backend_;
+      ring *ring_;
+   };
+
+   // note: impairments for one direction of a simulated link. chances are
+   //       in [0, 1], jitter adds up to jitter_ms_ on top of latency_ms_
+   //       without reordering, only reorder_ holds a datagram back an extra
+   //       reorder_ms_ so it falls behind later ones. bandwidth is in bytes
+   //       per second, zero means unlimited
+   struct network_conditions {
+      network_conditions();
+      explicit network_conditions(int64 latency_ms, int64 jitter_ms, float loss,
+                                  float duplicate = 0.0f, float reorder = 0.0f,
+                                  uint32 bandwidth = 0);
+
+      bool is_pass_through() const;
+
+      int64 latency_ms_;
+      int64 jitter_ms_;
+      float loss_;
+      float duplicate_;
+      float reorder_;
+      int64 reorder_ms_;
+      uint32 bandwidth_;
+   };
+
+   // note: decorator around udp_socket that runs every datagram through a
+   //       simulated link, one set of conditions per direction. in flight
+   //       datagrams wait on a timing wheel with one millisecond slots and
+   //       all randomness comes from a seeded generator, so a run can be
+   //       replayed. drop in for the send_to/recv_from/recv_batch calls
+   struct network_conditioner {
+      static constexpr uint32 wheel_slots = 1024;
+      static constexpr uint32 max_packets = 1024;
+      static constexpr int64 max_delay_ms = wheel_slots - 1;
+
+      struct packet {
+         ip_address address_;
+         uint32 next_;
+         uint32 size_;
+         bool outgoing_;
+         uint8 data_[packet_builder::mtu];
+      };
+
+      struct link {
+         network_conditions conditions_;
+         int64 free_at_us_;
+         int64 last_due_;
+      };
+
+      explicit network_conditioner(udp_socket &socket, uint32 seed = 1);
+      ~network_conditioner();
+      network_conditioner(const network_conditioner &) = delete;
+      network_conditioner &operator=(const network_conditioner &) = delete;
+
+      void set_conditions(const network_conditions &send, const network_conditions &receive);
+      void set_seed(uint32 seed);
+      void reset();
+
+      bool send_to(const ip_address &address, byte_stream &stream);
+      bool recv_from(ip_address &address, byte_stream &stream);
+      bool recv_batch(const uint32 count, ip_address *addresses, byte_stream *streams, uint32 &received);
+
+      // note: pulls pending datagrams off the socket and releases every one
+      //       that is due, the calls above run it on their own
+      void update(const time &now);
+
+      float next_random();
+      uint32 allocate();
+      void release(uint32 index);
+      void schedule(link &l, uint32 index, bool may_duplicate);
+      void deliver(uint32 index);
+      void push(uint32 &head, uint32 &tail, uint32 index);
+
+      udp_socket &socket_;
+      uint32 seed_;
+      uint32 random_;
+      link send_;
+      link receive_;
+      int64 now_;
+      packet *packets_;
+      uint32 free_;
+      uint32 ready_head_;
+      uint32 ready_tail_;
+      uint32 wheel_head_[wheel_slots];
+      uint32 wheel_tail_[wheel_slots];
+   };
+
+   // note: true if lhs is more recent than rhs, tolerates wrap around
+   bool sequence_greater_than(uint16 lhs, uint16 rhs);
+
+   // note: what one connection saw. malformed and duplicate datagrams are
+   //       dropped, out of order ones are older than the newest received
+   //       but still delivered. rtt comes from acks, interval is the time
+   //       between two received datagrams, both in milliseconds
+   struct connection_stats {
+      struct snapshot {
+         uint64 packets_sent_;
+         uint64 bytes_sent_;
+         uint64 packets_received_;
+         uint64 bytes_received_;
+         uint64 packets_acked_;
+         uint64 packets_lost_;
+         uint64 malformed_;
+         uint64 duplicates_;
+         uint64 out_of_order_;
+         histogram::snapshot rtt_;
+         histogram::snapshot interval_;
+      };
+
+      connection_stats();
+      connection_stats(const connection_stats &) = delete;
+      connection_stats &operator=(const connection_stats &) = delete;
+
+      void reset();
+      void read(snapshot &result) const;
+
+      std::atomic<uint64> packets_sent_;
+      std::atomic<uint64> bytes_sent_;
+      std::atomic<uint64> packets_received_;
+      std::atomic<uint64> bytes_received_;
+      std::atomic<uint64> packets_acked_;
+      std::atomic<uint64> packets_lost_;
+      std::atomic<uint64> malformed_;
+      std::atomic<uint64> duplicates_;
+      std::atomic<uint64> out_of_order_;
+      histogram rtt_;
+      histogram interval_;
+   };
+
+   // note: virtual connection on top of udp_socket. every datagram carries a
+   //       sequence number plus the latest remote sequence and a 32 bit ack
+   //       field. reliable messages are resent until acked and delivered in
+   //       order, unreliable messages ride along in the current packet only.
+   struct connection {
+      static constexpr uint32 packet_window = 256;
+      static constexpr uint32 reliable_window = 32;
+      static constexpr uint32 reliable_message_size = 128;
+      static constexpr uint32 reliable_per_packet = 8;
+      static constexpr int64 reliable_resend_ms = 100;
+
+      struct sent_packet {
+         uint16 sequence_;
+         bool valid_;
+         bool acked_;
+         int64 sent_at_;
+         uint32 reliable_count_;
+         uint16 reliable_ids_[reliable_per_packet];
+      };
+
+      struct reliable_message {
+         bool valid_;
+         uint16 id_;
+         uint32 size_;
+         int64 sent_at_;
+         uint8 data_[reliable_message_size];
+      };
+
+      connection();
+      connection(const connection &) = delete;
+      connection &operator=(const connection &) = delete;
+
+      void reset();
+
+      template <typename T>
+      bool send_reliable(T &message) {
+         if ((uint16)(send_id_ - send_oldest_id_) >= reliable_window) {
+            return false;
+         }
+
+         reliable_message &slot = send_queue_[send_id_ % reliable_window];
+         byte_stream stream(sizeof(slot.data_), slot.data_);
+         bit_writer writer(stream);
+         if (!message.serialize(writer) || !writer.flush()) {
+            return false;
+         }
+
+         slot.valid_ = true;
+         slot.id_ = send_id_++;
+         slot.size_ = (uint32)stream.length();
+         slot.sent_at_ = -1;
+
+         return true;
+      }
+
+      template <typename T>
+      bool send_unreliable(T &message) {
+         return unreliable_.push(message);
+      }
+
+      // note: builds the next datagram into stream, always produces a packet
+      //       so acks keep flowing even when there is nothing else to say
+      bool write_packet(const time &now, byte_stream &stream);
+
+      // note: false for malformed or duplicate datagrams. on success, new acks
+      //       are queued for poll_ack and unreliable_payload() covers the
+      //       unreliable messages of the packet
+      bool read_packet(const time &now, byte_stream &stream);
+
+      // note: hands out the next in order reliable message, the stream
+      //       stays valid until the next call to read_packet
+      bool receive_reliable(byte_stream &stream);
+      bool poll_ack(uint16 &sequence);
+      byte_stream &unreliable_payload();
+      uint16 next_sequence() const;
+
+      void on_ack(const time &now, uint16 sequence);
+      void detect_loss(uint16 ack);
+
+      uint16 sequence_;
+      uint16 remote_sequence_;
+      uint32 ack_bits_;
+      bool has_received_;
+      uint16 send_id_;
+      uint16 send_oldest_id_;
+      uint16 receive_id_;
+      sent_packet sent_[packet_window];
+      uint32 received_[packet_window];
+      reliable_message send_queue_[reliable_window];
+      reliable_message receive_queue_[reliable_window];
+      packet_builder unreliable_;
+      byte_stream unreliable_payload_;
+      dynamic_array<uint16> acks_;
+      uint32 acks_read_;
+
+      // note: a packet counts as lost once it falls out of the ack field
+      //       of the newest ack without having been acked
+      uint16 loss_cursor_;
+      int64 last_received_;
+      connection_stats stats_;
+   };
+
+   // note: round trip and clock offset estimate from ping/pong exchanges.
+   //       the round trip is smoothed with an ewma, jitter is its mean
+   //       deviation. the offset comes from the sample with the smallest
+   //       round trip in the recent window, the one least skewed by queueing.
+   //       offset is remote minus local time
+   struct clock_sync {
+      static constexpr int64 ping_interval_ms = 250;
+      static constexpr uint32 sample_window = 16;
+
+      struct sample {
+         int64 rtt_;
+         int64 offset_;
+      };
+
+      clock_sync();
+
+      void reset();
+      bool should_ping(const time &now);
+      void on_ping(const time &now, int64 remote_time);
+
+      // note: answer to the last ping, hold is how long it waited here
+      bool take_pong(const time &now, int64 &echo, int64 &hold);
+      void on_pong(const time &now, int64 echo, int64 remote_time, int64 hold);
+
+      bool is_valid() const;
+      float rtt_ms() const;
+      float jitter_ms() const;
+      int64 min_rtt_ms() const;
+      int64 offset_ms() const;
+      int64 to_local(int64 remote_tick) const;
+      int64 to_remote(int64 local_tick) const;
+
+      int64 next_ping_;
+      bool pong_pending_;
+      int64 pong_echo_;
+      int64 pong_received_;
+      uint32 sample_count_;
+      sample samples_[sample_window];
+      float rtt_;
+      float jitter_;
+      int64 min_rtt_;
+      int64 offset_;
+   };
+
+   // note: per connection send rate, aimd on packets per second. the rate
+   //       grows by a fixed step every period the link looks clean and is
+   //       halved on loss or when queueing pushes the rtt up. a token
+   //       bucket keeps it within the byte budget on top of that
+   struct rate_controller {
+      static constexpr int64 period_ms = 250;
+      static constexpr float increase_step = 2.0f;
+      static constexpr float decrease_factor = 0.5f;
+      static constexpr float loss_threshold = 0.02f;
+      static constexpr int64 queueing_limit_ms = 50;
+
+      rate_controller();
+
+      void reset();
+      void configure(int64 min_interval_ms, int64 max_interval_ms, uint32 budget);
+
+      // note: true when the interval has passed and the budget allows it,
+      //       report what went out with on_sent
+      bool should_send(const time &now);
+      void on_sent(const time &now, uint64 bytes);
+      void update(const time &now, const connection &c, const clock_sync &clock);
+
+      int64 interval_ms() const;
+      float rate() const;
+
+      int64 min_interval_ms_;
+      int64 max_interval_ms_;
+      uint32 budget_;
+      float rate_;
+      int64 next_send_;
+      float tokens_;
+      int64 refilled_at_;
+      int64 period_start_;
+      uint64 period_acked_;
+      uint64 period_lost_;
+      uint64 period_packets_;
+      uint64 period_bytes_;
+
+      // note: what the peer actually got over the last period
+      float packet_rate_;
+      float byte_rate_;
+      float loss_;
+      uint32 decreases_;
+      uint64 packets_sent_;
+      uint64 bytes_sent_;
+      uint64 budget_limited_;
+   };
+
+   // note: appends the counters of sockets and connections to a local text
+   //       file once per interval. one line per entry, a timestamp and name
+   //       followed by key=value pairs, so the file greps and plots easily
+   struct telemetry_log {
+      telemetry_log();
+      ~telemetry_log();
+      telemetry_log(const telemetry_log &) = delete;
+      telemetry_log &operator=(const telemetry_log &) = delete;
+
+      bool open(const char *path, int64 interval_ms);
+      void close();
+      bool is_open() const;
+
+      // note: true once per interval, write the entries and then flush
+      bool is_due(const time &now);
+      void write(const time &now, const char *name, const socket_stats &stats);
+      void write(const time &now, const char *name, uint32 id, const connection_stats &stats);
+      void flush();
+
+      void *file_;
+      int64 interval_ms_;
+      int64 next_;
+   };
+
    struct texture {
       texture();
 
@@ -345,15 +1094,23 @@ namespace gamma {
       vector2 extend_;
    };
 
+   // note: update runs on a fixed dt of tick_ms, as often as real time
+   //       calls for but at most max_catch_up_ticks times a frame. render
+   //       runs once a frame, alpha is how far into the next tick it is
    struct game_base {
+      static constexpr int64 tick_ms = 16;
+      static constexpr uint32 max_catch_up_ticks = 8;
+
       virtual ~game_base() = default;
       virtual bool enter() = 0;
       virtual void exit() = 0;
       virtual bool update(const time &dt, const keyboard &kb) = 0;
-      virtual void render(render_system &rs) = 0;
+      virtual void render(render_system &rs, float alpha) = 0;
    };
 
-   game_base *create_game(string &caption, video_mode &mode);
+   // note: cmd_line is the command line of the process without the
+   //       program name, empty when nothing was passed
+   game_base *create_game(const char *cmd_line, string &caption, video_mode &mode);
 } // !uu
 
 #endif // GAMMA_H_INCLUDED
@@ -0,0 +1,118 @@
+// clock_sync.cc
+
+#include "gamma.h"
+
+namespace gamma {
+   namespace {
+      // note: rfc 6298 gains, 1/8 for the mean and 1/4 for the deviation
+      constexpr float rtt_gain = 0.125f;
+      constexpr float jitter_gain = 0.25f;
+   } // !anon
+
+   clock_sync::clock_sync()
+   {
+      reset();
+   }
+
+   void clock_sync::reset() {
+      next_ping_ = 0;
+      pong_pending_ = false;
+      pong_echo_ = 0;
+      pong_received_ = 0;
+      sample_count_ = 0;
+      rtt_ = 0.0f;
+      jitter_ = 0.0f;
+      min_rtt_ = 0;
+      offset_ = 0;
+   }
+
+   bool clock_sync::should_ping(const time &now) {
+      if (now.tick_ < next_ping_) {
+         return false;
+      }
+
+      next_ping_ = now.tick_ + ping_interval_ms;
+      return true;
+   }
+
+   void clock_sync::on_ping(const time &now, int64 remote_time) {
+      // note: only the newest ping is answered
+      pong_pending_ = true;
+      pong_echo_ = remote_time;
+      pong_received_ = now.tick_;
+   }
+
+   bool clock_sync::take_pong(const time &now, int64 &echo, int64 &hold) {
+      if (!pong_pending_) {
+         return false;
+      }
+
+      pong_pending_ = false;
+      echo = pong_echo_;
+      hold = now.tick_ - pong_received_;
+      return true;
+   }
+
+   void clock_sync::on_pong(const time &now, int64 echo, int64 remote_time, int64 hold) {
+      const int64 rtt = now.tick_ - echo - hold;
+      if (echo > now.tick_ || hold < 0 || rtt < 0) {
+         return;
+      }
+
+      if (sample_count_ == 0) {
+         rtt_ = (float)rtt;
+         jitter_ = (float)rtt * 0.5f;
+      }
+      else {
+         const float error = (float)rtt - rtt_;
+         rtt_ += error * rtt_gain;
+         jitter_ += ((error < 0.0f ? -error : error) - jitter_) * jitter_gain;
+      }
+
+      // note: ntp style, the remote received at remote_time - hold and
+      //       answered at remote_time
+      sample &s = samples_[sample_count_ % sample_window];
+      s.rtt_ = rtt;
+      s.offset_ = ((remote_time - hold - echo) + (remote_time - now.tick_)) / 2;
+      sample_count_++;
+
+      const uint32 count = sample_count_ < sample_window ? sample_count_ : sample_window;
+      const sample *best = &samples_[0];
+      for (uint32 index = 1; index < count; index++) {
+         if (samples_[index].rtt_ < best->rtt_) {
+            best = &samples_[index];
+         }
+      }
+
+      min_rtt_ = best->rtt_;
+      offset_ = best->offset_;
+   }
+
+   bool clock_sync::is_valid() const {
+      return sample_count_ > 0;
+   }
+
+   float clock_sync::rtt_ms() const {
+      return rtt_;
+   }
+
+   float clock_sync::jitter_ms() const {
+      return jitter_;
+   }
+
+   int64 clock_sync::min_rtt_ms() const {
+      return min_rtt_;
+   }
+
+   int64 clock_sync::offset_ms() const {
+      return offset_;
+   }
+
+   int64 clock_sync::to_local(int64 remote_tick) const {
+      return remote_tick - offset_;
+   }
+
+   int64 clock_sync::to_remote(int64 local_tick) const {
+      return local_tick + offset_;
+   }
+} // !gamma
@@ -2,6 +2,11 @@
 
 #include "gamma.h"
 
+// note: glibc math.h declares a gamma() function that collides with the namespace
+#define gamma gamma_libm
+#include <math.h>
+#undef gamma
+
 namespace gamma {
    // static
    bool collider::overlap(const collider &lhs, const collider &rhs) {
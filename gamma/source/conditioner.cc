@@ -0,0 +1,310 @@
+// conditioner.cc
+
+#include "gamma.h"
+
+#include <string.h>
+
+namespace gamma {
+   namespace {
+      constexpr uint32 invalid_packet = ~0u;
+      constexpr int64 default_reorder_ms = 20;
+   } // !anon
+
+   network_conditions::network_conditions()
+      : latency_ms_(0)
+      , jitter_ms_(0)
+      , loss_(0.0f)
+      , duplicate_(0.0f)
+      , reorder_(0.0f)
+      , reorder_ms_(default_reorder_ms)
+      , bandwidth_(0)
+   {
+   }
+
+   network_conditions::network_conditions(int64 latency_ms, int64 jitter_ms, float loss,
+                                          float duplicate, float reorder, uint32 bandwidth)
+      : latency_ms_(latency_ms)
+      , jitter_ms_(jitter_ms)
+      , loss_(loss)
+      , duplicate_(duplicate)
+      , reorder_(reorder)
+      , reorder_ms_(default_reorder_ms)
+      , bandwidth_(bandwidth)
+   {
+   }
+
+   bool network_conditions::is_pass_through() const {
+      return latency_ms_ <= 0 && jitter_ms_ <= 0 && loss_ <= 0.0f &&
+             duplicate_ <= 0.0f && reorder_ <= 0.0f && bandwidth_ == 0;
+   }
+
+   network_conditioner::network_conditioner(udp_socket &socket, uint32 seed)
+      : socket_(socket)
+      , seed_(seed)
+      , packets_(new packet[max_packets])
+   {
+      reset();
+   }
+
+   network_conditioner::~network_conditioner() {
+      delete[] packets_;
+   }
+
+   void network_conditioner::set_conditions(const network_conditions &send, const network_conditions &receive) {
+      send_.conditions_ = send;
+      receive_.conditions_ = receive;
+   }
+
+   void network_conditioner::set_seed(uint32 seed) {
+      seed_ = seed;
+      random_ = seed_ ? seed_ : 1;
+   }
+
+   void network_conditioner::reset() {
+      // note: drops everything in flight, keeps the conditions
+      random_ = seed_ ? seed_ : 1;
+      now_ = -1;
+      send_.free_at_us_ = 0;
+      send_.last_due_ = 0;
+      receive_.free_at_us_ = 0;
+      receive_.last_due_ = 0;
+
+      for (uint32 index = 0; index < max_packets; index++) {
+         packets_[index].next_ = index + 1 < max_packets ? index + 1 : invalid_packet;
+      }
+      free_ = 0;
+      ready_head_ = invalid_packet;
+      ready_tail_ = invalid_packet;
+      for (uint32 slot = 0; slot < wheel_slots; slot++) {
+         wheel_head_[slot] = invalid_packet;
+         wheel_tail_[slot] = invalid_packet;
+      }
+   }
+
+   bool network_conditioner::send_to(const ip_address &address, byte_stream &stream) {
+      update(time::now());
+
+      if (send_.conditions_.is_pass_through()) {
+         return socket_.send_to(address, stream);
+      }
+
+      const uint64 size = stream.length();
+      if (size > packet_builder::mtu) {
+         return false;
+      }
+
+      // note: a full queue behaves like a congested link, the datagram is lost
+      const uint32 index = allocate();
+      if (index == invalid_packet) {
+         return true;
+      }
+
+      packet &p = packets_[index];
+      p.address_ = address;
+      p.size_ = (uint32)size;
+      p.outgoing_ = true;
+      memcpy(p.data_, stream.base_, (size_t)size);
+      schedule(send_, index, true);
+
+      return true;
+   }
+
+   bool network_conditioner::recv_from(ip_address &address, byte_stream &stream) {
+      update(time::now());
+
+      if (ready_head_ == invalid_packet) {
+         if (receive_.conditions_.is_pass_through()) {
+            return socket_.recv_from(address, stream);
+         }
+         return false;
+      }
+
+      const uint32 index = ready_head_;
+      packet &p = packets_[index];
+      ready_head_ = p.next_;
+      if (ready_head_ == invalid_packet) {
+         ready_tail_ = invalid_packet;
+      }
+
+      // note: like a real datagram socket, whatever does not fit is cut off
+      const uint64 size = p.size_ < stream.capacity() ? p.size_ : stream.capacity();
+      memcpy(stream.base_, p.data_, (size_t)size);
+      stream.at_ = stream.base_ + size;
+      address = p.address_;
+      release(index);
+
+      return true;
+   }
+
+   bool network_conditioner::recv_batch(const uint32 count, ip_address *addresses, byte_stream *streams, uint32 &received) {
+      update(time::now());
+
+      // note: nothing held back and nothing to hold back, keep the batched read
+      if (ready_head_ == invalid_packet && receive_.conditions_.is_pass_through()) {
+         return socket_.recv_batch(count, addresses, streams, received);
+      }
+
+      for (received = 0; received < count; received++) {
+         if (!recv_from(addresses[received], streams[received])) {
+            break;
+         }
+      }
+
+      return received > 0;
+   }
+
+   void network_conditioner::update(const time &now) {
+      if (now_ < 0) {
+         now_ = now.tick_;
+      }
+
+      // note: after a stall longer than one turn every slot is due anyway
+      int64 steps = now.tick_ - now_;
+      if (steps > (int64)wheel_slots) {
+         steps = wheel_slots;
+      }
+      for (int64 step = 1; step <= steps; step++) {
+         const uint32 slot = (uint32)((now_ + step) % wheel_slots);
+         uint32 index = wheel_head_[slot];
+         wheel_head_[slot] = invalid_packet;
+         wheel_tail_[slot] = invalid_packet;
+         while (index != invalid_packet) {
+            const uint32 next = packets_[index].next_;
+            deliver(index);
+            index = next;
+         }
+      }
+      if (now.tick_ > now_) {
+         now_ = now.tick_;
+      }
+
+      if (receive_.conditions_.is_pass_through()) {
+         return;
+      }
+
+      // note: the kernel queue keeps whatever does not fit into the pool
+      uint32 index = allocate();
+      while (index != invalid_packet) {
+         packet &p = packets_[index];
+         byte_stream stream(sizeof(p.data_), p.data_);
+         if (!socket_.recv_from(p.address_, stream)) {
+            release(index);
+            break;
+         }
+
+         p.size_ = (uint32)stream.length();
+         p.outgoing_ = false;
+         schedule(receive_, index, true);
+         index = allocate();
+      }
+   }
+
+   float network_conditioner::next_random() {
+      // note: xorshift32, private to this conditioner so runs replay exactly
+      random_ ^= random_ << 13;
+      random_ ^= random_ >> 17;
+      random_ ^= random_ << 5;
+      return (random_ >> 8) / 16777216.0f;
+   }
+
+   uint32 network_conditioner::allocate() {
+      const uint32 index = free_;
+      if (index != invalid_packet) {
+         free_ = packets_[index].next_;
+         packets_[index].next_ = invalid_packet;
+      }
+
+      return index;
+   }
+
+   void network_conditioner::release(uint32 index) {
+      packets_[index].next_ = free_;
+      free_ = index;
+   }
+
+   void network_conditioner::schedule(link &l, uint32 index, bool may_duplicate) {
+      const network_conditions &c = l.conditions_;
+      if (next_random() < c.loss_) {
+         release(index);
+         return;
+      }
+
+      if (may_duplicate && next_random() < c.duplicate_) {
+         const uint32 copy = allocate();
+         if (copy != invalid_packet) {
+            packets_[copy].address_ = packets_[index].address_;
+            packets_[copy].size_ = packets_[index].size_;
+            packets_[copy].outgoing_ = packets_[index].outgoing_;
+            memcpy(packets_[copy].data_, packets_[index].data_, packets_[index].size_);
+            schedule(l, copy, false);
+         }
+      }
+
+      // note: the link serializes one datagram at a time, a backlog longer
+      //       than the wheel can hold overflows the queue
+      int64 departure = now_;
+      if (c.bandwidth_ > 0) {
+         const int64 now_us = now_ * 1000;
+         const int64 start_us = l.free_at_us_ > now_us ? l.free_at_us_ : now_us;
+         if (start_us - now_us > max_delay_ms * 1000) {
+            release(index);
+            return;
+         }
+
+         l.free_at_us_ = start_us + (int64)packets_[index].size_ * 1000000 / c.bandwidth_;
+         departure = l.free_at_us_ / 1000;
+      }
+
+      int64 due = departure + c.latency_ms_;
+      if (c.jitter_ms_ > 0) {
+         due += (int64)(next_random() * (float)(c.jitter_ms_ + 1));
+      }
+
+      if (next_random() < c.reorder_) {
+         due += c.reorder_ms_;
+      }
+      else {
+         // note: jitter alone keeps the order, a datagram never overtakes
+         //       the one queued before it
+         if (due < l.last_due_) {
+            due = l.last_due_;
+         }
+         l.last_due_ = due;
+      }
+
+      if (due > now_ + max_delay_ms) {
+         due = now_ + max_delay_ms;
+      }
+      if (due <= now_) {
+         deliver(index);
+         return;
+      }
+
+      const uint32 slot = (uint32)(due % wheel_slots);
+      push(wheel_head_[slot], wheel_tail_[slot], index);
+   }
+
+   void network_conditioner::deliver(uint32 index) {
+      packet &p = packets_[index];
+      if (!p.outgoing_) {
+         push(ready_head_, ready_tail_, index);
+         return;
+      }
+
+      byte_stream stream(sizeof(p.data_), p.data_);
+      stream.at_ = stream.base_ + p.size_;
+      socket_.send_to(p.address_, stream);
+      release(index);
+   }
+
+   void network_conditioner::push(uint32 &head, uint32 &tail, uint32 index) {
+      packets_[index].next_ = invalid_packet;
+      if (tail == invalid_packet) {
+         head = index;
+      }
+      else {
+         packets_[tail].next_ = index;
+      }
+      tail = index;
+   }
+} // !gamma
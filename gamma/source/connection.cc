@@ -0,0 +1,333 @@
+// connection.cc
+
+#include "gamma.h"
+
+namespace gamma {
+   namespace {
+      // note: sequence, ack and 32 bit ack field
+      constexpr uint32 packet_header_size = 2 + 2 + 4;
+
+      // note: id plus a worst case varint size in front of every reliable message
+      constexpr uint32 reliable_overhead = 2 + 2;
+
+      bool skip_bytes(bit_reader &reader, uint32 count) {
+         uint8 value = 0;
+         for (uint32 index = 0; index < count; index++) {
+            if (!reader.serialize(value)) {
+               return false;
+            }
+         }
+
+         return true;
+      }
+   } // !anon
+
+   bool sequence_greater_than(uint16 lhs, uint16 rhs) {
+      return ((lhs > rhs) && (lhs - rhs <= 32768)) ||
+             ((lhs < rhs) && (rhs - lhs > 32768));
+   }
+
+   connection::connection()
+   {
+      reset();
+   }
+
+   void connection::reset() {
+      // note: acks for a sequence we have not sent yet until the first packet arrives
+      sequence_ = 0;
+      remote_sequence_ = 0xffff;
+      ack_bits_ = 0;
+      has_received_ = false;
+      send_id_ = 0;
+      send_oldest_id_ = 0;
+      receive_id_ = 0;
+
+      for (auto &packet : sent_) {
+         packet.valid_ = false;
+      }
+      for (auto &sequence : received_) {
+         sequence = ~0u;
+      }
+      for (auto &message : send_queue_) {
+         message.valid_ = false;
+      }
+      for (auto &message : receive_queue_) {
+         message.valid_ = false;
+      }
+
+      unreliable_.reset();
+      unreliable_payload_ = byte_stream();
+      acks_.clear();
+      acks_read_ = 0;
+
+      loss_cursor_ = 0;
+      last_received_ = -1;
+      stats_.reset();
+   }
+
+   bool connection::write_packet(const time &now, byte_stream &stream) {
+      stream.reset();
+      bit_writer writer(stream);
+
+      if (!writer.serialize(sequence_) ||
+          !writer.serialize(remote_sequence_) ||
+          !writer.serialize(ack_bits_)) {
+         return false;
+      }
+
+      sent_packet &packet = sent_[sequence_ % packet_window];
+      packet.sequence_ = sequence_;
+      packet.valid_ = true;
+      packet.acked_ = false;
+      packet.sent_at_ = now.tick_;
+      packet.reliable_count_ = 0;
+
+      // note: pick reliable messages that were never sent or are due for a resend,
+      //       reserving room for whatever unreliable messages were queued this tick
+      unreliable_.writer_.flush();
+      const uint64 unreliable_size = unreliable_.stream_.length();
+      uint64 budget = stream.capacity() - packet_header_size - 1;
+      budget = budget > unreliable_size ? budget - unreliable_size : 0;
+
+      reliable_message *pending[reliable_per_packet] = {};
+      for (uint16 id = send_oldest_id_; id != send_id_; id++) {
+         if (packet.reliable_count_ == reliable_per_packet) {
+            break;
+         }
+
+         reliable_message &message = send_queue_[id % reliable_window];
+         if (!message.valid_ || message.id_ != id) {
+            continue;
+         }
+         if (message.sent_at_ >= 0 && now.tick_ - message.sent_at_ < reliable_resend_ms) {
+            continue;
+         }
+         if (message.size_ + reliable_overhead > budget) {
+            break;
+         }
+
+         budget -= message.size_ + reliable_overhead;
+         pending[packet.reliable_count_] = &message;
+         packet.reliable_ids_[packet.reliable_count_++] = id;
+      }
+
+      if (!writer.serialize_varint(packet.reliable_count_)) {
+         return false;
+      }
+
+      for (uint32 index = 0; index < packet.reliable_count_; index++) {
+         reliable_message &message = *pending[index];
+         if (!writer.serialize(message.id_) ||
+             !writer.serialize_varint(message.size_) ||
+             !writer.serialize(message.size_, message.data_)) {
+            return false;
+         }
+
+         message.sent_at_ = now.tick_;
+      }
+
+      if (!writer.flush()) {
+         return false;
+      }
+
+      // note: everything before is byte aligned, unreliable bytes are appended as is
+      if (stream.length() + unreliable_size <= stream.capacity()) {
+         for (uint64 index = 0; index < unreliable_size; index++) {
+            *stream.at_++ = unreliable_.buffer_[index];
+         }
+      }
+
+      unreliable_.reset();
+      sequence_++;
+      telemetry_add(stats_.packets_sent_, 1);
+      telemetry_add(stats_.bytes_sent_, stream.length());
+
+      return true;
+   }
+
+   bool connection::read_packet(const time &now, byte_stream &stream) {
+      bit_reader reader(stream);
+      telemetry_add(stats_.packets_received_, 1);
+      telemetry_add(stats_.bytes_received_, stream.length());
+
+      uint16 sequence = 0;
+      uint16 ack = 0;
+      uint32 ack_bits = 0;
+      if (!reader.serialize(sequence) ||
+          !reader.serialize(ack) ||
+          !reader.serialize(ack_bits)) {
+         telemetry_add(stats_.malformed_, 1);
+         return false;
+      }
+
+      if (received_[sequence % packet_window] == sequence) {
+         telemetry_add(stats_.duplicates_, 1);
+         return false;
+      }
+
+      uint32 reliable_count = 0;
+      if (!reader.serialize_varint(reliable_count) || reliable_count > reliable_per_packet) {
+         telemetry_add(stats_.malformed_, 1);
+         return false;
+      }
+
+      for (uint32 index = 0; index < reliable_count; index++) {
+         uint16 id = 0;
+         uint32 size = 0;
+         if (!reader.serialize(id) ||
+             !reader.serialize_varint(size) ||
+             size > reliable_message_size) {
+            telemetry_add(stats_.malformed_, 1);
+            return false;
+         }
+
+         // note: drop what was already delivered or lies outside the window
+         const bool stale = sequence_greater_than(receive_id_, id);
+         const bool ahead = (uint16)(id - receive_id_) >= reliable_window;
+         reliable_message &message = receive_queue_[id % reliable_window];
+         if (stale || ahead || (message.valid_ && message.id_ == id)) {
+            if (!skip_bytes(reader, size)) {
+               telemetry_add(stats_.malformed_, 1);
+               return false;
+            }
+            continue;
+         }
+
+         if (!reader.serialize(size, message.data_)) {
+            telemetry_add(stats_.malformed_, 1);
+            return false;
+         }
+
+         message.valid_ = true;
+         message.id_ = id;
+         message.size_ = size;
+         message.sent_at_ = now.tick_;
+      }
+
+      // note: the packet is well formed, commit its sequence and acks
+      received_[sequence % packet_window] = sequence;
+      if (last_received_ >= 0) {
+         stats_.interval_.record(now.tick_ - last_received_);
+      }
+      last_received_ = now.tick_;
+
+      if (!has_received_) {
+         has_received_ = true;
+         remote_sequence_ = sequence;
+         ack_bits_ = 0;
+      }
+      else if (sequence_greater_than(sequence, remote_sequence_)) {
+         // note: the previous remote sequence moves into the field at shift - 1
+         const uint32 shift = (uint16)(sequence - remote_sequence_);
+         if (shift < 32) {
+            ack_bits_ = (ack_bits_ << shift) | (1u << (shift - 1));
+         }
+         else if (shift == 32) {
+            ack_bits_ = 1u << 31;
+         }
+         else {
+            ack_bits_ = 0;
+         }
+         remote_sequence_ = sequence;
+      }
+      else {
+         telemetry_add(stats_.out_of_order_, 1);
+         const uint32 distance = (uint16)(remote_sequence_ - sequence);
+         if (distance <= 32) {
+            ack_bits_ |= 1u << (distance - 1);
+         }
+      }
+
+      on_ack(now, ack);
+      for (uint32 bit = 0; bit < 32; bit++) {
+         if (ack_bits & (1u << bit)) {
+            on_ack(now, (uint16)(ack - bit - 1));
+         }
+      }
+      detect_loss(ack);
+
+      assert(reader.scratch_bits_ == 0);
+      const uint64 remaining = reader.bits_remaining() / 8;
+      unreliable_payload_ = byte_stream(remaining, reader.cursor_);
+      unreliable_payload_.at_ = reader.cursor_ + remaining;
+
+      return true;
+   }
+
+   bool connection::receive_reliable(byte_stream &stream) {
+      reliable_message &message = receive_queue_[receive_id_ % reliable_window];
+      if (!message.valid_ || message.id_ != receive_id_) {
+         return false;
+      }
+
+      message.valid_ = false;
+      receive_id_++;
+
+      stream = byte_stream(message.size_, message.data_);
+      stream.at_ = message.data_ + message.size_;
+
+      return true;
+   }
+
+   bool connection::poll_ack(uint16 &sequence) {
+      if (acks_read_ == acks_.size()) {
+         acks_.clear();
+         acks_read_ = 0;
+         return false;
+      }
+
+      sequence = acks_[acks_read_++];
+
+      return true;
+   }
+
+   byte_stream &connection::unreliable_payload() {
+      return unreliable_payload_;
+   }
+
+   uint16 connection::next_sequence() const {
+      return sequence_;
+   }
+
+   void connection::on_ack(const time &now, uint16 sequence) {
+      sent_packet &packet = sent_[sequence % packet_window];
+      if (!packet.valid_ || packet.sequence_ != sequence || packet.acked_) {
+         return;
+      }
+
+      packet.acked_ = true;
+      acks_.push_back(sequence);
+      telemetry_add(stats_.packets_acked_, 1);
+      stats_.rtt_.record(now.tick_ - packet.sent_at_);
+
+      for (uint32 index = 0; index < packet.reliable_count_; index++) {
+         const uint16 id = packet.reliable_ids_[index];
+         reliable_message &message = send_queue_[id % reliable_window];
+         if (message.valid_ && message.id_ == id) {
+            message.valid_ = false;
+         }
+      }
+
+      while (send_oldest_id_ != send_id_) {
+         const reliable_message &message = send_queue_[send_oldest_id_ % reliable_window];
+         if (message.valid_ && message.id_ == send_oldest_id_) {
+            break;
+         }
+         send_oldest_id_++;
+      }
+   }
+
+   void connection::detect_loss(uint16 ack) {
+      // note: the remote acks 0xffff until it has seen a packet, which is
+      //       older than anything sent, so nothing is counted before then
+      while (loss_cursor_ != sequence_ &&
+             sequence_greater_than(ack, loss_cursor_) &&
+             (uint16)(ack - loss_cursor_) > 32) {
+         const sent_packet &packet = sent_[loss_cursor_ % packet_window];
+         if (packet.valid_ && packet.sequence_ == loss_cursor_ && !packet.acked_) {
+            telemetry_add(stats_.packets_lost_, 1);
+         }
+         loss_cursor_++;
+      }
+   }
+} // !gamma
@@ -0,0 +1,90 @@
+// hash.cc
+
+// note: rand_s is only declared when this precedes every crt header
+#define _CRT_RAND_S 1
+#define _CRT_SECURE_NO_WARNINGS 1
+#include "gamma.h"
+
+#if defined(_WIN32)
+#include <stdlib.h>
+#else
+#include <stdio.h>
+#endif
+
+namespace gamma {
+   namespace hash {
+      namespace {
+         uint64 rotate_left(uint64 value, uint32 bits) {
+            return (value << bits) | (value >> (64 - bits));
+         }
+
+         void sip_round(uint64 (&v)[4]) {
+            v[0] += v[1]; v[1] = rotate_left(v[1], 13); v[1] ^= v[0]; v[0] = rotate_left(v[0], 32);
+            v[2] += v[3]; v[3] = rotate_left(v[3], 16); v[3] ^= v[2];
+            v[0] += v[3]; v[3] = rotate_left(v[3], 21); v[3] ^= v[0];
+            v[2] += v[1]; v[1] = rotate_left(v[1], 17); v[1] ^= v[2]; v[2] = rotate_left(v[2], 32);
+         }
+
+         // note: input words are little endian whatever the host is
+         uint64 read_word(const uint8 *data, uint32 size) {
+            uint64 result = 0;
+            for (uint32 index = 0; index < size; index++) {
+               result |= (uint64)data[index] << (8 * index);
+            }
+            return result;
+         }
+      } // !anon
+
+      uint64 siphash(const uint64 (&key)[2], const void *data, uint64 size) {
+         uint64 v[4] = {
+            key[0] ^ 0x736f6d6570736575ull,
+            key[1] ^ 0x646f72616e646f6dull,
+            key[0] ^ 0x6c7967656e657261ull,
+            key[1] ^ 0x7465646279746573ull,
+         };
+
+         const uint8 *bytes = (const uint8 *)data;
+         const uint64 blocks = size / 8;
+         for (uint64 block = 0; block < blocks; block++) {
+            const uint64 word = read_word(bytes + block * 8, 8);
+            v[3] ^= word;
+            sip_round(v);
+            sip_round(v);
+            v[0] ^= word;
+         }
+
+         const uint64 last = ((size & 0xff) << 56) | read_word(bytes + blocks * 8, (uint32)(size & 7));
+         v[3] ^= last;
+         sip_round(v);
+         sip_round(v);
+         v[0] ^= last;
+
+         v[2] ^= 0xff;
+         sip_round(v);
+         sip_round(v);
+         sip_round(v);
+         sip_round(v);
+
+         return v[0] ^ v[1] ^ v[2] ^ v[3];
+      }
+
+      void random_key(uint64 (&key)[2]) {
+#if defined(_WIN32)
+         for (auto &word : key) {
+            unsigned int high = 0, low = 0;
+            rand_s(&high);
+            rand_s(&low);
+            word = ((uint64)high << 32) | low;
+         }
+#else
+         key[0] = 0;
+         key[1] = 0;
+         FILE *file = fopen("/dev/urandom", "rb");
+         if (file) {
+            fread(key, sizeof(key), 1, file);
+            fclose(file);
+         }
+#endif
+      }
+   } // !hash
+} // !gamma
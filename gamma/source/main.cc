@@ -177,7 +177,7 @@ int WINAPI WinMain(HINSTANCE instance, HINSTANCE prev_instance, LPSTR cmd_line,
 
    gamma::string caption = "gamma";
    gamma::video_mode mode(width, height);
-   gamma::game_base *game = gamma::create_game(caption, mode);
+   gamma::game_base *game = gamma::create_game(cmd_line, caption, mode);
    if (!game->enter()) {
       gamma::system::message_box("Could not create game instance!");
       return -1;
@@ -186,6 +186,9 @@ int WINAPI WinMain(HINSTANCE instance, HINSTANCE prev_instance, LPSTR cmd_line,
    SetWindowTextA(window, caption.c_str());
    gamma::video_mode::set_mode(mode);
 
+   const gamma::time tick(gamma::game_base::tick_ms);
+   gamma::time accumulator(0);
+
    bool running = true;
    while (running) {
       MSG msg = {};
@@ -196,17 +199,36 @@ int WINAPI WinMain(HINSTANCE instance, HINSTANCE prev_instance, LPSTR cmd_line,
          TranslateMessage(&msg);
          DispatchMessage(&msg);
       }
-      input_state_process(is, kb);
 
       gamma::time current = gamma::time::now();
       gamma::time dt = (current - time);
       time = current;
-      
-      running = running && game->update(dt, kb);
+      accumulator = accumulator + dt;
+
+      // note: the simulation only ever sees whole ticks. a frame that fell
+      //       further behind than max_catch_up_ticks drops the rest instead
+      //       of making the next frame even slower. keys are sampled per
+      //       tick so a press is seen by exactly one update
+      gamma::uint32 ticks = 0;
+      while (running && accumulator.tick_ >= tick.tick_) {
+         if (ticks == gamma::game_base::max_catch_up_ticks) {
+            accumulator = gamma::time(accumulator.tick_ % tick.tick_);
+            break;
+         }
 
-      game->render(rs);
+         input_state_process(is, kb);
+         running = game->update(tick, kb);
+         accumulator = accumulator - tick;
+         ticks++;
+      }
+
+      const float alpha = (float)accumulator.tick_ / (float)tick.tick_;
+      game->render(rs, alpha);
       SwapBuffers(device);
-      Sleep(16);
+
+      // note: nothing changes before the next tick is due
+      const gamma::int64 idle = tick.tick_ - accumulator.tick_;
+      Sleep(running && idle > 0 ? (DWORD)idle : 0);
    }
 
    delete game;
@@ -3,12 +3,37 @@
 #define _CRT_SECURE_NO_WARNINGS 1
 #include "gamma.h"
 
+#include <string.h>
+
+#if defined(_WIN32)
 #include <WinSock2.h>
 #include <WS2tcpip.h>
 #include <iphlpapi.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/filter.h>
+#endif
 
 namespace gamma {
    namespace network {
+      // note: upper bound of datagrams moved per recvmmsg/sendmmsg call
+      constexpr uint32 batch_max = 64;
+
       sockaddr_in to_sockaddr(const ip_address &addr) {
          sockaddr_in result = {};
          result.sin_family = AF_INET;
@@ -21,6 +46,32 @@ namespace gamma {
          return ip_address(ntohl(addr.sin_addr.s_addr), htons(addr.sin_port));
       }
 
+      void close_handle(uint32 handle) {
+#if defined(_WIN32)
+         closesocket(handle);
+#else
+         ::close((int)handle);
+#endif
+      }
+
+      bool set_non_blocking(uint32 handle) {
+#if defined(_WIN32)
+         u_long non_blocking = 1;
+         return ioctlsocket(handle, FIONBIO, &non_blocking) == 0;
+#else
+         int flags = fcntl((int)handle, F_GETFL, 0);
+         if (flags == -1) {
+            return false;
+         }
+         return fcntl((int)handle, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+      }
+
+      uint32 reuse_port_index(const ip_address &address, const uint32 count) {
+         return count ? (address.host_ ^ address.port_) % count : 0;
+      }
+
+#if defined(_WIN32)
       bool init() {
          WSADATA data = {};
          int result = WSAStartup(MAKEWORD(2, 2), &data);
@@ -30,8 +81,17 @@ namespace gamma {
       void shut() {
          WSACleanup();
       }
+#else
+      bool init() {
+         return true;
+      }
+
+      void shut() {
+      }
+#endif
 
       namespace error {
+#if defined(_WIN32)
          network_error_code get_error() {
             int error_code = WSAGetLastError();
             switch (error_code) {
@@ -149,6 +209,96 @@ namespace gamma {
 
             return NETERR_UNKNOWN;
          }
+#else
+         network_error_code get_error() {
+            int error_code = errno;
+            switch (error_code) {
+               case 0:
+                  return NETERR_NO_ERROR;
+               case ENOMEM:
+                  return NETERR_NOT_ENOUGH_MEMORY;
+               case EINTR:
+                  return NETERR_INTERUPTED_CALL;
+               case EBADF:
+                  return NETERR_BAD_FILE_HANDLE;
+               case EACCES:
+                  return NETERR_SOCKET_ACCESS_DENIED;
+               case EFAULT:
+                  return NETERR_BAD_ADDRESS;
+               case EINVAL:
+                  return NETERR_INVALID_ARGUMENT;
+               case EMFILE:
+                  return NETERR_TOO_MANY_OPEN_FILES;
+               case EWOULDBLOCK:
+#if EAGAIN != EWOULDBLOCK
+               case EAGAIN:
+#endif
+                  return NETERR_WOULD_BLOCK;
+               case EINPROGRESS:
+                  return NETERR_IN_PROGRESS;
+               case EALREADY:
+                  return NETERR_ALREADY_IN_PROGRESS;
+               case ENOTSOCK:
+                  return NETERR_HANDLE_NON_SOCKET;
+               case EDESTADDRREQ:
+                  return NETERR_DESTINATION_ADDRESS_REQUIRED;
+               case EMSGSIZE:
+                  return NETERR_MESSAGE_TOO_LONG;
+               case EPROTOTYPE:
+                  return NETERR_WRONG_PROTOTYPE;
+               case ENOPROTOOPT:
+                  return NETERR_BAD_PROTOCOL_OPTION;
+               case EPROTONOSUPPORT:
+                  return NETERR_PROTOCOL_NOT_SUPPORTED;
+               case ESOCKTNOSUPPORT:
+                  return NETERR_SOCKET_TYPE_NOT_SUPPORTED;
+               case EOPNOTSUPP:
+                  return NETERR_OPERATION_NOT_SUPPORTED;
+               case EPFNOSUPPORT:
+                  return NETERR_PROTOCOL_FAMILY_NOT_SUPPORT;
+               case EAFNOSUPPORT:
+                  return NETERR_ADDRESS_FAMILY_NOT_SUPPORT;
+               case EADDRINUSE:
+                  return NETERR_ADDRESS_IN_USE;
+               case EADDRNOTAVAIL:
+                  return NETERR_ADDRESS_NOT_AVAILABLE;
+               case ENETDOWN:
+                  return NETERR_NETWORK_DOWN;
+               case ENETUNREACH:
+                  return NETERR_NETWORK_UNREACHABLE;
+               case ENETRESET:
+                  return NETERR_NETWORK_DROPPED_CONNECTION;
+               case ECONNABORTED:
+                  return NETERR_CONNECTION_RESET_BY_SOFTWARE;
+               case ECONNRESET:
+                  return NETERR_CONNECTION_RESET_BY_PEER;
+               case ENOBUFS:
+                  return NETERR_NO_BUFFER_SPACE_AVAIABLE;
+               case EISCONN:
+                  return NETERR_ALREADY_CONNECTED;
+               case ENOTCONN:
+                  return NETERR_NOT_CONNECTED;
+               case ESHUTDOWN:
+                  return NETERR_SEND_SHUTDOWN;
+               case ETOOMANYREFS:
+                  return NETERR_TOO_MANY_REFS;
+               case ETIMEDOUT:
+                  return NETERR_CONNECTION_TIMED_OUT;
+               case ECONNREFUSED:
+                  return NETERR_CONNECTION_REFUSED;
+               case ELOOP:
+                  return NETERR_TRANSLATE_NAME;
+               case ENAMETOOLONG:
+                  return NETERR_NAME_TOO_LONG;
+               case EHOSTDOWN:
+                  return NETERR_HOST_DOWN;
+               case EHOSTUNREACH:
+                  return NETERR_HOST_UNREACHABLE;
+            }
+
+            return NETERR_UNKNOWN;
+         }
+#endif
 
          const char *as_string(network_error_code error_code) {
             switch (error_code) {
@@ -283,6 +433,7 @@ namespace gamma {
       } // !error
    } // !network
 
+#if defined(_WIN32)
    // static
    bool ip_address::local_addresses(dynamic_array<ip_address> &addresses) {
       DWORD size = 0;
@@ -319,15 +470,43 @@ namespace gamma {
 
       return !addresses.empty();
    }
+#else
+   // static
+   bool ip_address::local_addresses(dynamic_array<ip_address> &addresses) {
+      ifaddrs *interface_addresses = NULL;
+      if (getifaddrs(&interface_addresses) != 0) {
+         return false;
+      }
+
+      for (ifaddrs *iter = interface_addresses; iter != NULL; iter = iter->ifa_next) {
+         if (iter->ifa_addr == NULL || iter->ifa_addr->sa_family != AF_INET) {
+            continue;
+         }
+         if ((iter->ifa_flags & IFF_UP) == 0 || (iter->ifa_flags & IFF_LOOPBACK) != 0) {
+            continue;
+         }
+
+         sockaddr_in ai = *(sockaddr_in *)iter->ifa_addr;
+         ip_address address;
+         address.host_ = ntohl(ai.sin_addr.s_addr);
+         address.port_ = ntohs(ai.sin_port);
+         addresses.push_back(address);
+      }
+
+      freeifaddrs(interface_addresses);
+
+      return !addresses.empty();
+   }
+#endif
 
    bool ip_address::lookup(const string &dns, dynamic_array<ip_address> &addresses) {
-      ADDRINFO *query_result = NULL;
-      ADDRINFO hint = {};
+      addrinfo *query_result = NULL;
+      addrinfo hint = {};
       hint.ai_family = AF_INET;
       hint.ai_socktype = SOCK_DGRAM;
       bool result = getaddrinfo(dns.c_str(), NULL, &hint, &query_result) == 0;
       if (result) {
-         ADDRINFO *iter = query_result;
+         addrinfo *iter = query_result;
          while (iter) {
             sockaddr_in addrin = *(sockaddr_in *)iter->ai_addr;
             ip_address address;
@@ -339,7 +518,9 @@ namespace gamma {
          }
       }
 
-      freeaddrinfo(query_result);
+      if (query_result) {
+         freeaddrinfo(query_result);
+      }
 
       return !addresses.empty();
    }
@@ -367,7 +548,7 @@ namespace gamma {
    }
 
    bool ip_address::operator==(const ip_address &rhs) const {
-      return host_ == rhs.host_;
+      return host_ == rhs.host_ && port_ == rhs.port_;
    }
 
    void ip_address::set_host(uint8 a, uint8 b, uint8 c, uint8 d) {
@@ -408,34 +589,51 @@ namespace gamma {
          return;
       }
 
-      closesocket(handle_);
+      network::close_handle(handle_);
       handle_ = ~0u;
    }
 
-   bool udp_socket::open(ip_address &addr) {
+   bool udp_socket::open(ip_address &addr, const uint32 flags) {
       if (is_valid()) {
          return false;
       }
 
+#if !defined(SO_REUSEPORT)
+      if (flags & OPEN_REUSE_PORT) {
+         return false;
+      }
+#endif
+
       uint32_t handle = (int)socket(AF_INET, SOCK_DGRAM, 0);
       if (handle == ~0u) {
          return false;
       }
 
       // note: enable non-blocking mode
-      u_long non_blocking = 1;
-      if (ioctlsocket(handle, FIONBIO, &non_blocking) != 0) {
+      if (!network::set_non_blocking(handle)) {
+         network::close_handle(handle);
          return false;
       }
 
       // note: enable address reuse mode
-      BOOL value = TRUE;
+      int value = 1;
       if (setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, (const char *)&value, sizeof(value)) != 0) {
+         network::close_handle(handle);
          return false;
       }
 
+#if defined(SO_REUSEPORT)
+      if (flags & OPEN_REUSE_PORT) {
+         if (setsockopt(handle, SOL_SOCKET, SO_REUSEPORT, (const char *)&value, sizeof(value)) != 0) {
+            network::close_handle(handle);
+            return false;
+         }
+      }
+#endif
+
       sockaddr_in addr_in = network::to_sockaddr(addr);
       if (bind(handle, (const sockaddr *)&addr_in, sizeof(addr_in)) != 0) {
+         network::close_handle(handle);
          return false;
       }
 
@@ -444,6 +642,34 @@ namespace gamma {
       return true;
    }
 
+   bool udp_socket::attach_reuse_port_program(const uint32 count) {
+      if (!is_valid() || count == 0) {
+         return false;
+      }
+
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+      // note: the program sees the skb past the udp header, the addresses are
+      //       reached relative to the network header. assumes ipv4 without
+      //       options, mirrors network::reuse_port_index
+      sock_filter code[] = {
+         { BPF_LD  | BPF_W   | BPF_ABS, 0, 0, (uint32)SKF_NET_OFF + 12 },  // a = source host
+         { BPF_MISC | BPF_TAX,          0, 0, 0 },                         // x = a
+         { BPF_LD  | BPF_H   | BPF_ABS, 0, 0, (uint32)SKF_NET_OFF + 20 },  // a = source port
+         { BPF_ALU | BPF_XOR | BPF_X,   0, 0, 0 },                         // a ^= x
+         { BPF_ALU | BPF_MOD | BPF_K,   0, 0, count },                     // a %= count
+         { BPF_RET | BPF_A,             0, 0, 0 },
+      };
+
+      sock_fprog program = {};
+      program.len = (unsigned short)(sizeof(code) / sizeof(code[0]));
+      program.filter = code;
+
+      return setsockopt((int)handle_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)) == 0;
+#else
+      return false;
+#endif
+   }
+
    bool udp_socket::send_to(const ip_address &address, byte_stream &stream) {
       if (!is_valid()) {
          return false;
@@ -456,11 +682,13 @@ namespace gamma {
       while (sent < size) {
          int result = sendto(handle_, data + sent, size - sent, 0, (const sockaddr *)&addr_in, sizeof(addr_in));
          if (result < 0) {
+            stats_.on_error(network::error::get_error());
             return false;
          }
 
          sent += result;
       }
+      stats_.on_sent((uint64)size);
 
       return true;
    }
@@ -473,11 +701,13 @@ namespace gamma {
       char *base = (char *)stream.base_;
       int size = (int)stream.capacity();
       sockaddr_in addr_in = {};
-      int remote_size = sizeof(addr_in);
-      int result = recvfrom(handle_, base, size, 0, (sockaddr *)&addr_in, &remote_size);
+      socklen_t remote_size = sizeof(addr_in);
+      int result = (int)recvfrom(handle_, base, size, 0, (sockaddr *)&addr_in, &remote_size);
       if (result < 0) {
+         stats_.on_error(network::error::get_error());
          return false;
       }
+      stats_.on_received((uint64)result);
 
       address.host_ = ntohl(addr_in.sin_addr.s_addr);
       address.port_ = ntohs(addr_in.sin_port);
@@ -486,12 +716,173 @@ namespace gamma {
       return true;
    }
 
+#if defined(__linux__)
+   bool udp_socket::send_batch(const uint32 count, const ip_address *addresses, byte_stream *streams, uint32 &sent) {
+      sent = 0;
+      if (!is_valid()) {
+         return false;
+      }
+
+      mmsghdr headers[network::batch_max];
+      iovec vectors[network::batch_max];
+      sockaddr_in names[network::batch_max];
+      while (sent < count) {
+         const uint32 batch = (count - sent) < network::batch_max ? (count - sent) : network::batch_max;
+         for (uint32 index = 0; index < batch; index++) {
+            names[index] = network::to_sockaddr(addresses[sent + index]);
+            vectors[index].iov_base = streams[sent + index].base_;
+            vectors[index].iov_len = (size_t)streams[sent + index].length();
+
+            headers[index] = {};
+            headers[index].msg_hdr.msg_name = &names[index];
+            headers[index].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            headers[index].msg_hdr.msg_iov = &vectors[index];
+            headers[index].msg_hdr.msg_iovlen = 1;
+         }
+
+         int result = sendmmsg((int)handle_, headers, batch, 0);
+         if (result <= 0) {
+            stats_.on_error(network::error::get_error());
+            return false;
+         }
+
+         for (int index = 0; index < result; index++) {
+            stats_.on_sent(vectors[index].iov_len);
+         }
+         sent += (uint32)result;
+      }
+
+      return true;
+   }
+
+   bool udp_socket::recv_batch(const uint32 count, ip_address *addresses, byte_stream *streams, uint32 &received) {
+      received = 0;
+      if (!is_valid()) {
+         return false;
+      }
+
+      mmsghdr headers[network::batch_max];
+      iovec vectors[network::batch_max];
+      sockaddr_in names[network::batch_max];
+      while (received < count) {
+         const uint32 batch = (count - received) < network::batch_max ? (count - received) : network::batch_max;
+         for (uint32 index = 0; index < batch; index++) {
+            byte_stream &stream = streams[received + index];
+            vectors[index].iov_base = stream.base_;
+            vectors[index].iov_len = (size_t)stream.capacity();
+
+            headers[index] = {};
+            headers[index].msg_hdr.msg_name = &names[index];
+            headers[index].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            headers[index].msg_hdr.msg_iov = &vectors[index];
+            headers[index].msg_hdr.msg_iovlen = 1;
+         }
+
+         int result = recvmmsg((int)handle_, headers, batch, MSG_DONTWAIT, NULL);
+         if (result <= 0) {
+            stats_.on_error(network::error::get_error());
+            break;
+         }
+
+         for (int index = 0; index < result; index++) {
+            byte_stream &stream = streams[received + index];
+            stream.at_ = stream.base_ + headers[index].msg_len;
+            addresses[received + index] = network::from_sockaddr(names[index]);
+            stats_.on_received(headers[index].msg_len);
+         }
+
+         received += (uint32)result;
+         if ((uint32)result < batch) {
+            // note: socket queue drained, no need for another syscall
+            break;
+         }
+      }
+
+      return received > 0;
+   }
+
+   bool udp_socket::send_fanout(const uint32 count, const ip_address *addresses, const byte_stream &stream, uint32 &sent) {
+      sent = 0;
+      if (!is_valid()) {
+         return false;
+      }
+
+      // note: udp gso would split one buffer into segments for a single
+      //       destination, peers differ here so only the iovec is shared
+      iovec vector;
+      vector.iov_base = stream.base_;
+      vector.iov_len = (size_t)stream.length();
+
+      mmsghdr headers[network::batch_max];
+      sockaddr_in names[network::batch_max];
+      while (sent < count) {
+         const uint32 batch = (count - sent) < network::batch_max ? (count - sent) : network::batch_max;
+         for (uint32 index = 0; index < batch; index++) {
+            names[index] = network::to_sockaddr(addresses[sent + index]);
+
+            headers[index] = {};
+            headers[index].msg_hdr.msg_name = &names[index];
+            headers[index].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            headers[index].msg_hdr.msg_iov = &vector;
+            headers[index].msg_hdr.msg_iovlen = 1;
+         }
+
+         int result = sendmmsg((int)handle_, headers, batch, 0);
+         if (result <= 0) {
+            stats_.on_error(network::error::get_error());
+            return false;
+         }
+
+         for (int index = 0; index < result; index++) {
+            stats_.on_sent(vector.iov_len);
+         }
+         sent += (uint32)result;
+      }
+
+      return true;
+   }
+#else
+   bool udp_socket::send_batch(const uint32 count, const ip_address *addresses, byte_stream *streams, uint32 &sent) {
+      // note: no sendmmsg on this platform, fall back to one call per datagram
+      for (sent = 0; sent < count; sent++) {
+         if (!send_to(addresses[sent], streams[sent])) {
+            return false;
+         }
+      }
+
+      return true;
+   }
+
+   bool udp_socket::recv_batch(const uint32 count, ip_address *addresses, byte_stream *streams, uint32 &received) {
+      // note: no recvmmsg on this platform, fall back to one call per datagram
+      for (received = 0; received < count; received++) {
+         if (!recv_from(addresses[received], streams[received])) {
+            break;
+         }
+      }
+
+      return received > 0;
+   }
+
+   bool udp_socket::send_fanout(const uint32 count, const ip_address *addresses, const byte_stream &stream, uint32 &sent) {
+      // note: no sendmmsg on this platform, fall back to one call per peer
+      byte_stream shared = stream;
+      for (sent = 0; sent < count; sent++) {
+         if (!send_to(addresses[sent], shared)) {
+            return false;
+         }
+      }
+
+      return true;
+   }
+#endif
+
    bool udp_socket::address_of(ip_address &address) {
       if (!is_valid()) {
          return false;
       }
 
-      int size = sizeof(sockaddr_in);
+      socklen_t size = sizeof(sockaddr_in);
       sockaddr_in addr_in = {};
       addr_in.sin_family = AF_INET;
       if (getsockname(handle_, (sockaddr *)& addr_in, &size) != 0) {
@@ -503,6 +894,13 @@ namespace gamma {
       return true;
    }
 
+   byte_stream::byte_stream()
+      : capacity_(0)
+      , base_(nullptr)
+      , at_(nullptr)
+   {
+   }
+
    byte_stream::byte_stream(uint64 capacity, uint8 *base)
       : capacity_(capacity)
       , base_(base)
@@ -528,10 +926,32 @@ namespace gamma {
          return length + size > stream.capacity();
       }
 
+      bool is_past_stream_data(const byte_stream &stream, const uint8 *cursor, const uint64 size) {
+         uint32 length = (uint32)(cursor - stream.base_);
+         return length + size > stream.length();
+      }
+
+      // note: the wire is little endian. memcpy keeps the access defined at
+      //       any alignment and still compiles down to a single move
+      template <typename T>
+      T to_little_endian(T value) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+         T result = 0;
+         for (uint32 index = 0; index < sizeof(T); index++) {
+            result = (T)((result << 8) | (value & 0xff));
+            value = (T)(value >> 8);
+         }
+         return result;
+#else
+         return value;
+#endif
+      }
+
       template <typename T>
       bool write_to(byte_stream &stream, uint8 *&cursor, T value) {
          if (!is_past_stream_end(stream, cursor, sizeof(T))) {
-            *reinterpret_cast<T *>(cursor) = value;
+            value = to_little_endian(value);
+            memcpy(cursor, &value, sizeof(T));
             cursor += sizeof(T);
             return true;
          }
@@ -539,10 +959,58 @@ namespace gamma {
          return false;
       }
 
+      uint32 quantize(float value, const float min, const float max, const float resolution) {
+         if (value < min) {
+            value = min;
+         }
+         else if (value > max) {
+            value = max;
+         }
+
+         return (uint32)((value - min) / resolution + 0.5f);
+      }
+
+      float dequantize(const uint32 value, const float min, const float max, const float resolution) {
+         const float result = min + value * resolution;
+         return result > max ? max : result;
+      }
+
+      // note: 7 bits of payload per byte, high bit set while more bytes follow
+      template <typename S>
+      bool write_varint(S &stream, uint32 value) {
+         while (value >= 0x80) {
+            if (!stream.serialize_bits((value & 0x7f) | 0x80, 8)) {
+               return false;
+            }
+            value >>= 7;
+         }
+
+         return stream.serialize_bits(value, 8);
+      }
+
+      template <typename S>
+      bool read_varint(S &stream, uint32 &value) {
+         value = 0;
+         for (uint32 shift = 0; shift < 35; shift += 7) {
+            uint32 group = 0;
+            if (!stream.serialize_bits(group, 8)) {
+               return false;
+            }
+
+            value |= (group & 0x7f) << shift;
+            if ((group & 0x80) == 0) {
+               return true;
+            }
+         }
+
+         return false;
+      }
+
       template <typename T> 
       bool read_from(byte_stream &stream, uint8 *&cursor, T &value) {
-         if (!is_past_stream_end(stream, cursor, sizeof(T))) {
-            value = *reinterpret_cast<T *>(cursor);
+         if (!is_past_stream_data(stream, cursor, sizeof(T))) {
+            memcpy(&value, cursor, sizeof(T));
+            value = to_little_endian(value);
             cursor += sizeof(T);
             return true;
          }
@@ -597,6 +1065,30 @@ namespace gamma {
       return false;
    }
 
+   bool byte_stream_writer::serialize_bits(uint32 value, const uint32 bits) {
+      assert(bits <= 32);
+      if (bits <= 8) {
+         return serialize((uint8)value);
+      }
+      else if (bits <= 16) {
+         return serialize((uint16)value);
+      }
+
+      return serialize(value);
+   }
+
+   bool byte_stream_writer::serialize_bool(bool value) {
+      return serialize_bits(value ? 1u : 0u, 1);
+   }
+
+   bool byte_stream_writer::serialize_varint(uint32 value) {
+      return write_varint(*this, value);
+   }
+
+   bool byte_stream_writer::serialize_float(float value, const float min, const float max, const float resolution) {
+      return serialize_bits(quantize(value, min, max, resolution), bits_required(min, max, resolution));
+   }
+
    byte_stream_reader::byte_stream_reader(byte_stream &stream)
       : stream_(stream)
       , cursor_(stream.base_)
@@ -638,7 +1130,7 @@ namespace gamma {
    bool byte_stream_reader::serialize(const uint32 count, uint8 *values) {
       const uint32 size = count * sizeof(uint8);
 
-      if (!is_past_stream_end(stream_, cursor_, size)) {
+      if (!is_past_stream_data(stream_, cursor_, size)) {
          for (uint32 index = 0; index < count; index++) {
             values[index] = cursor_[index];
          }
@@ -650,4 +1142,340 @@ namespace gamma {
 
       return false;
    }
+
+   bool byte_stream_reader::serialize_bits(uint32 &value, const uint32 bits) {
+      assert(bits <= 32);
+      if (bits <= 8) {
+         uint8 result = 0;
+         if (!serialize(result)) {
+            return false;
+         }
+         value = result;
+         return true;
+      }
+      else if (bits <= 16) {
+         uint16 result = 0;
+         if (!serialize(result)) {
+            return false;
+         }
+         value = result;
+         return true;
+      }
+
+      return serialize(value);
+   }
+
+   bool byte_stream_reader::serialize_bool(bool &value) {
+      uint32 result = 0;
+      if (!serialize_bits(result, 1)) {
+         return false;
+      }
+
+      value = result != 0;
+      return true;
+   }
+
+   bool byte_stream_reader::serialize_varint(uint32 &value) {
+      return read_varint(*this, value);
+   }
+
+   bool byte_stream_reader::serialize_float(float &value, const float min, const float max, const float resolution) {
+      uint32 result = 0;
+      if (!serialize_bits(result, bits_required(min, max, resolution))) {
+         return false;
+      }
+
+      value = dequantize(result, min, max, resolution);
+      return true;
+   }
+
+   bool byte_stream_reader::peek(uint8 &value) const {
+      if (is_past_stream_data(stream_, cursor_, sizeof(uint8))) {
+         return false;
+      }
+
+      value = *cursor_;
+
+      return true;
+   }
+
+   bool byte_stream_reader::is_at_end() const {
+      return is_past_stream_data(stream_, cursor_, sizeof(uint8));
+   }
+
+   bit_writer::bit_writer(byte_stream &stream)
+      : stream_(stream)
+      , scratch_(0)
+      , scratch_bits_(0)
+   {
+   }
+
+   bool bit_writer::serialize(float value) {
+      union  {
+         float  f;
+         uint32 u;
+      } f2u;
+      f2u.f = value;
+      return serialize(f2u.u);
+   }
+
+   bool bit_writer::serialize(uint64 value) {
+      return serialize_bits((uint32)(value & 0xffffffffu), 32) &&
+             serialize_bits((uint32)(value >> 32), 32);
+   }
+
+   bool bit_writer::serialize(uint32 value) {
+      return serialize_bits(value, 32);
+   }
+
+   bool bit_writer::serialize(uint16 value) {
+      return serialize_bits(value, 16);
+   }
+
+   bool bit_writer::serialize(uint8 value) {
+      return serialize_bits(value, 8);
+   }
+
+   bool bit_writer::serialize(const uint32 count, const uint8 *values) {
+      for (uint32 index = 0; index < count; index++) {
+         if (!serialize_bits(values[index], 8)) {
+            return false;
+         }
+      }
+
+      return true;
+   }
+
+   bool bit_writer::serialize_bits(uint32 value, const uint32 bits) {
+      assert(bits <= 32);
+      if (bits == 0) {
+         return true;
+      }
+
+      // note: the partial byte kept in scratch has to fit once flushed
+      const uint64 pending = (scratch_bits_ + bits + 7) / 8;
+      if (is_past_stream_end(stream_, stream_.at_, pending)) {
+         return false;
+      }
+
+      const uint64 mask = bits == 32 ? 0xffffffffull : ((1ull << bits) - 1);
+      scratch_ |= ((uint64)value & mask) << scratch_bits_;
+      scratch_bits_ += bits;
+      while (scratch_bits_ >= 8) {
+         *stream_.at_++ = (uint8)(scratch_ & 0xff);
+         scratch_ >>= 8;
+         scratch_bits_ -= 8;
+      }
+
+      return true;
+   }
+
+   bool bit_writer::serialize_bool(bool value) {
+      return serialize_bits(value ? 1u : 0u, 1);
+   }
+
+   bool bit_writer::serialize_varint(uint32 value) {
+      return write_varint(*this, value);
+   }
+
+   bool bit_writer::serialize_float(float value, const float min, const float max, const float resolution) {
+      return serialize_bits(quantize(value, min, max, resolution), bits_required(min, max, resolution));
+   }
+
+   bool bit_writer::flush() {
+      if (scratch_bits_ == 0) {
+         return true;
+      }
+
+      if (is_past_stream_end(stream_, stream_.at_, 1)) {
+         return false;
+      }
+
+      *stream_.at_++ = (uint8)(scratch_ & 0xff);
+      scratch_ = 0;
+      scratch_bits_ = 0;
+
+      return true;
+   }
+
+   void bit_writer::reset() {
+      stream_.reset();
+      scratch_ = 0;
+      scratch_bits_ = 0;
+   }
+
+   uint64 bit_writer::bits_written() const {
+      return stream_.length() * 8 + scratch_bits_;
+   }
+
+   bit_reader::bit_reader(byte_stream &stream)
+      : stream_(stream)
+      , cursor_(stream.base_)
+      , scratch_(0)
+      , scratch_bits_(0)
+   {
+   }
+
+   bool bit_reader::serialize(float &value) {
+      union 
+      {
+         uint32 u;
+         float  f;
+      } u2f;
+
+      if (!serialize(u2f.u)) {
+         return false;
+      }
+
+      value = u2f.f;
+
+      return true;
+   }
+
+   bool bit_reader::serialize(uint64 &value) {
+      uint32 low = 0, high = 0;
+      if (!serialize_bits(low, 32) || !serialize_bits(high, 32)) {
+         return false;
+      }
+
+      value = ((uint64)high << 32) | low;
+      return true;
+   }
+
+   bool bit_reader::serialize(uint32 &value) {
+      return serialize_bits(value, 32);
+   }
+
+   bool bit_reader::serialize(uint16 &value) {
+      uint32 result = 0;
+      if (!serialize_bits(result, 16)) {
+         return false;
+      }
+
+      value = (uint16)result;
+      return true;
+   }
+
+   bool bit_reader::serialize(uint8 &value) {
+      uint32 result = 0;
+      if (!serialize_bits(result, 8)) {
+         return false;
+      }
+
+      value = (uint8)result;
+      return true;
+   }
+
+   bool bit_reader::serialize(const uint32 count, uint8 *values) {
+      for (uint32 index = 0; index < count; index++) {
+         if (!serialize(values[index])) {
+            return false;
+         }
+      }
+
+      return true;
+   }
+
+   bool bit_reader::serialize_bits(uint32 &value, const uint32 bits) {
+      assert(bits <= 32);
+      if (bits == 0) {
+         value = 0;
+         return true;
+      }
+
+      if (bits > bits_remaining()) {
+         return false;
+      }
+
+      while (scratch_bits_ < bits) {
+         scratch_ |= (uint64)(*cursor_++) << scratch_bits_;
+         scratch_bits_ += 8;
+      }
+
+      const uint64 mask = bits == 32 ? 0xffffffffull : ((1ull << bits) - 1);
+      value = (uint32)(scratch_ & mask);
+      scratch_ >>= bits;
+      scratch_bits_ -= bits;
+
+      return true;
+   }
+
+   bool bit_reader::serialize_bool(bool &value) {
+      uint32 result = 0;
+      if (!serialize_bits(result, 1)) {
+         return false;
+      }
+
+      value = result != 0;
+      return true;
+   }
+
+   bool bit_reader::serialize_varint(uint32 &value) {
+      return read_varint(*this, value);
+   }
+
+   bool bit_reader::serialize_float(float &value, const float min, const float max, const float resolution) {
+      uint32 result = 0;
+      if (!serialize_bits(result, bits_required(min, max, resolution))) {
+         return false;
+      }
+
+      value = dequantize(result, min, max, resolution);
+      return true;
+   }
+
+   bool bit_reader::peek(uint8 &value) const {
+      if (bits_remaining() < 8) {
+         return false;
+      }
+
+      uint64 scratch = scratch_;
+      uint32 scratch_bits = scratch_bits_;
+      const uint8 *cursor = cursor_;
+      while (scratch_bits < 8) {
+         scratch |= (uint64)(*cursor++) << scratch_bits;
+         scratch_bits += 8;
+      }
+
+      value = (uint8)(scratch & 0xff);
+
+      return true;
+   }
+
+   bool bit_reader::is_at_end() const {
+      // note: writers pad the final byte with zeros, anything
+      //       short of a whole byte cannot be another message
+      return bits_remaining() < 8;
+   }
+
+   uint64 bit_reader::bits_remaining() const {
+      return (stream_.length() - (uint64)(cursor_ - stream_.base_)) * 8 + scratch_bits_;
+   }
+
+   packet_builder::packet_builder()
+      : count_(0)
+      , stream_(sizeof(buffer_), buffer_)
+      , writer_(stream_)
+   {
+   }
+
+   bool packet_builder::is_empty() const {
+      return count_ == 0;
+   }
+
+   void packet_builder::reset() {
+      count_ = 0;
+      writer_.reset();
+   }
+
+   bool packet_builder::flush(udp_socket &socket, const ip_address &address) {
+      if (is_empty()) {
+         return true;
+      }
+
+      bool result = writer_.flush() && socket.send_to(address, stream_);
+      reset();
+
+      return result;
+   }
 } // !uu
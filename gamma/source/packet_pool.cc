@@ -0,0 +1,107 @@
+// packet_pool.cc
+
+#include "gamma.h"
+
+namespace gamma {
+   namespace {
+      // note: the head packs a tag above the index, every successful swap
+      //       bumps the tag so a stale compare cannot succeed (aba)
+      uint64 make_head(uint64 head, uint32 index) {
+         return (((head >> 32) + 1) << 32) | index;
+      }
+   } // !anon
+
+   packet_pool::packet_pool()
+      : memory_(nullptr)
+      , base_(nullptr)
+      , next_(nullptr)
+      , count_(0)
+      , head_((uint64)invalid_index)
+      , available_(0)
+   {
+   }
+
+   packet_pool::~packet_pool() {
+      destroy();
+   }
+
+   bool packet_pool::is_valid() const {
+      return memory_ != nullptr;
+   }
+
+   bool packet_pool::create(uint32 count) {
+      if (is_valid()) {
+         destroy();
+      }
+      if (count == 0 || count == invalid_index) {
+         return false;
+      }
+
+      // note: default initialized, the buffers are never zeroed
+      memory_ = new uint8[(uint64)count * buffer_size + cache_line];
+      base_ = (uint8 *)(((uintptr_t)memory_ + cache_line - 1) & ~(uintptr_t)(cache_line - 1));
+      next_ = new std::atomic<uint32>[count];
+      for (uint32 index = 0; index < count; index++) {
+         next_[index].store(index + 1 < count ? index + 1 : invalid_index, std::memory_order_relaxed);
+      }
+
+      count_ = count;
+      available_.store(count, std::memory_order_relaxed);
+      head_.store(0, std::memory_order_release);
+
+      return true;
+   }
+
+   void packet_pool::destroy() {
+      if (!is_valid()) {
+         return;
+      }
+
+      assert(available_.load() == count_);
+      delete[] next_;
+      delete[] memory_;
+      memory_ = nullptr;
+      base_ = nullptr;
+      next_ = nullptr;
+      count_ = 0;
+      head_.store((uint64)invalid_index);
+      available_.store(0);
+   }
+
+   bool packet_pool::acquire(byte_stream &stream) {
+      uint64 head = head_.load(std::memory_order_acquire);
+      for (;;) {
+         const uint32 index = (uint32)head;
+         if (index == invalid_index) {
+            return false;
+         }
+
+         const uint32 next = next_[index].load(std::memory_order_relaxed);
+         if (head_.compare_exchange_weak(head, make_head(head, next),
+                                         std::memory_order_acquire,
+                                         std::memory_order_acquire)) {
+            available_.fetch_sub(1, std::memory_order_relaxed);
+            stream = byte_stream(packet_builder::mtu, base_ + (uint64)index * buffer_size);
+            return true;
+         }
+      }
+   }
+
+   void packet_pool::release(byte_stream &stream) {
+      assert(stream.base_ >= base_ && stream.base_ < base_ + (uint64)count_ * buffer_size);
+      const uint32 index = (uint32)((stream.base_ - base_) / buffer_size);
+      stream = byte_stream();
+
+      uint64 head = head_.load(std::memory_order_relaxed);
+      do {
+         next_[index].store((uint32)head, std::memory_order_relaxed);
+      } while (!head_.compare_exchange_weak(head, make_head(head, index),
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed));
+      available_.fetch_add(1, std::memory_order_relaxed);
+   }
+
+   uint32 packet_pool::available() const {
+      return available_.load(std::memory_order_relaxed);
+   }
+} // !gamma
@@ -2,7 +2,8 @@
 
 #include "gamma.h"
 
-static int next = 1;
+// note: per thread so server workers never race on the generator
+static thread_local int next = 1;
 void random_seed(int s) {
    next = s;
 }
@@ -0,0 +1,133 @@
+// rate_controller.cc
+
+#include "gamma.h"
+
+namespace gamma {
+   namespace {
+      // note: the bucket holds at most this much of the budget
+      constexpr float burst_seconds = 0.1f;
+   } // !anon
+
+   rate_controller::rate_controller()
+      : min_interval_ms_(16)
+      , max_interval_ms_(100)
+      , budget_(16000)
+   {
+      reset();
+   }
+
+   void rate_controller::reset() {
+      // note: start at the slowest rate, it has to be earned
+      rate_ = 1000.0f / (float)max_interval_ms_;
+      next_send_ = 0;
+      tokens_ = (float)budget_ * burst_seconds;
+      refilled_at_ = -1;
+      period_start_ = -1;
+      period_acked_ = 0;
+      period_lost_ = 0;
+      period_packets_ = 0;
+      period_bytes_ = 0;
+
+      packet_rate_ = 0.0f;
+      byte_rate_ = 0.0f;
+      loss_ = 0.0f;
+      decreases_ = 0;
+      packets_sent_ = 0;
+      bytes_sent_ = 0;
+      budget_limited_ = 0;
+   }
+
+   void rate_controller::configure(int64 min_interval_ms, int64 max_interval_ms, uint32 budget) {
+      assert(min_interval_ms > 0 && min_interval_ms <= max_interval_ms);
+      min_interval_ms_ = min_interval_ms;
+      max_interval_ms_ = max_interval_ms;
+      budget_ = budget;
+      reset();
+   }
+
+   bool rate_controller::should_send(const time &now) {
+      if (refilled_at_ < 0) {
+         refilled_at_ = now.tick_;
+      }
+
+      if (budget_ > 0) {
+         const float capacity = (float)budget_ * burst_seconds;
+         tokens_ += (float)(now.tick_ - refilled_at_) * (float)budget_ * 0.001f;
+         tokens_ = tokens_ < capacity ? tokens_ : capacity;
+      }
+      refilled_at_ = now.tick_;
+
+      if (now.tick_ < next_send_) {
+         return false;
+      }
+      if (budget_ > 0 && tokens_ < 0.0f) {
+         budget_limited_++;
+         return false;
+      }
+
+      return true;
+   }
+
+   void rate_controller::on_sent(const time &now, uint64 bytes) {
+      // note: the bucket may go into debt by one packet, it is paid back
+      //       before the next one goes out
+      tokens_ -= (float)bytes;
+      next_send_ = now.tick_ + interval_ms();
+
+      period_packets_++;
+      period_bytes_ += bytes;
+      packets_sent_++;
+      bytes_sent_ += bytes;
+   }
+
+   void rate_controller::update(const time &now, const connection &c, const clock_sync &clock) {
+      const uint64 total_acked = c.stats_.packets_acked_.load(std::memory_order_relaxed);
+      const uint64 total_lost = c.stats_.packets_lost_.load(std::memory_order_relaxed);
+      if (period_start_ < 0) {
+         period_start_ = now.tick_;
+         period_acked_ = total_acked;
+         period_lost_ = total_lost;
+         return;
+      }
+
+      const int64 elapsed = now.tick_ - period_start_;
+      if (elapsed < period_ms) {
+         return;
+      }
+
+      const uint64 acked = total_acked - period_acked_;
+      const uint64 lost = total_lost - period_lost_;
+      loss_ = acked + lost > 0 ? (float)lost / (float)(acked + lost) : 0.0f;
+      packet_rate_ = (float)period_packets_ * 1000.0f / (float)elapsed;
+      byte_rate_ = (float)period_bytes_ * 1000.0f / (float)elapsed;
+
+      const bool queueing = clock.is_valid() &&
+                            clock.rtt_ms() - (float)clock.min_rtt_ms() > (float)queueing_limit_ms;
+      if (loss_ > loss_threshold || queueing) {
+         rate_ *= decrease_factor;
+         decreases_++;
+      }
+      else if (packet_rate_ >= rate_ * 0.5f) {
+         // note: only grow a rate that is actually being used
+         rate_ += increase_step;
+      }
+
+      const float min_rate = 1000.0f / (float)max_interval_ms_;
+      const float max_rate = 1000.0f / (float)min_interval_ms_;
+      rate_ = rate_ < min_rate ? min_rate : (rate_ > max_rate ? max_rate : rate_);
+
+      period_start_ = now.tick_;
+      period_acked_ = total_acked;
+      period_lost_ = total_lost;
+      period_packets_ = 0;
+      period_bytes_ = 0;
+   }
+
+   int64 rate_controller::interval_ms() const {
+      return (int64)(1000.0f / rate_ + 0.5f);
+   }
+
+   float rate_controller::rate() const {
+      return rate_;
+   }
+} // !gamma
@@ -4,6 +4,80 @@
 
 #include "gamma.h"
 
+#if defined(GAMMA_HEADLESS)
+// note: headless builds (the match server) keep sprites and textures as plain
+//       data so the simulation links without a window or an opengl context
+namespace gamma {
+   render_system::render_system()
+      : texture_(0)
+   {
+   }
+
+   render_system::~render_system()
+   {
+   }
+
+   void render_system::clear(uint32) {
+   }
+
+   void render_system::draw_text(int, int, uint32, int, const char *, ...) {
+   }
+
+   void render_system::draw(const uint32, const rectangle &) {
+   }
+
+   void render_system::draw(const texture &, const rectangle &, const rectangle &) {
+   }
+
+   texture::texture()
+      : handle_(0)
+      , width_(0)
+      , height_(0)
+   {
+   }
+
+   bool texture::is_valid() const {
+      return handle_ != 0;
+   }
+
+   bool texture::create_from_file(const char *) {
+      return false;
+   }
+
+   bool texture::create_from_memory(int, int, void *) {
+      return false;
+   }
+
+   void texture::destroy() {
+   }
+
+   sprite::sprite()
+      : image_(nullptr)
+   {
+   }
+
+   void sprite::set_texture(const texture &image) {
+      image_ = &image;
+   }
+
+   void sprite::set_source(const rectangle &rect) {
+      source_ = rect;
+   }
+
+   void sprite::set_size(const vector2 &size) {
+      destination_.width_ = size.x_;
+      destination_.height_ = size.y_;
+   }
+
+   void sprite::set_position(const vector2 &position) {
+      destination_.x_ = position.x_;
+      destination_.y_ = position.y_;
+   }
+
+   void sprite::render(render_system &) {
+   }
+} // !gamma
+#else
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 #include <gl/GL.h>
@@ -458,3 +532,4 @@ namespace gamma {
       }
    }
 } // !uu
+#endif // GAMMA_HEADLESS
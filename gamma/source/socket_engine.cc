@@ -0,0 +1,587 @@
+// socket_engine.cc
+
+#include "gamma.h"
+
+#if defined(_WIN32)
+#include <WinSock2.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <errno.h>
+#include <string.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace gamma {
+#if defined(__linux__)
+   namespace {
+      // note: user_data of the multishot receive, sends carry their slot
+      constexpr uint64 receive_tag = ~0ull;
+      constexpr uint16 buffer_group = 0;
+
+      int ring_setup(uint32 entries, io_uring_params *params) {
+         return (int)syscall(__NR_io_uring_setup, entries, params);
+      }
+
+      int ring_enter(int fd, uint32 submit, uint32 wait, uint32 flags) {
+         return (int)syscall(__NR_io_uring_enter, fd, submit, wait, flags, nullptr, 0);
+      }
+
+      int ring_register(int fd, uint32 opcode, void *arg, uint32 count) {
+         return (int)syscall(__NR_io_uring_register, fd, opcode, arg, count);
+      }
+   } // !anon
+
+   // note: the mapped rings and everything the kernel reads from while a
+   //       request is in flight, so it never moves
+   struct socket_engine::ring {
+      ring()
+         : fd_(-1)
+         , stats_(nullptr)
+         , sq_map_(nullptr)
+         , sq_map_size_(0)
+         , cq_map_(nullptr)
+         , cq_map_size_(0)
+         , sqes_(nullptr)
+         , sqes_size_(0)
+         , buffers_(nullptr)
+         , buffers_size_(0)
+         , memory_(nullptr)
+         , buffer_tail_(0)
+         , to_submit_(0)
+         , receive_armed_(false)
+         , ready_head_(0)
+         , ready_tail_(0)
+         , handed_count_(0)
+         , sends_inflight_(0)
+         , sends_failed_(0)
+      {
+         memset(&receive_header_, 0, sizeof(receive_header_));
+      }
+
+      bool create(int socket, socket_stats &stats);
+      void destroy();
+
+      io_uring_sqe *next_sqe();
+      bool submit(uint32 wait);
+      void arm_receive();
+      void recycle(uint16 id);
+      void publish_buffers();
+      void reap();
+      void record_error(int code);
+      bool has_completions() const;
+
+      int fd_;
+      int socket_;
+      socket_stats *stats_;
+      uint8 *sq_map_;
+      size_t sq_map_size_;
+      uint8 *cq_map_;
+      size_t cq_map_size_;
+      uint32 *sq_head_;
+      uint32 *sq_tail_;
+      uint32 sq_mask_;
+      uint32 sq_entries_;
+      uint32 *sq_array_;
+      io_uring_sqe *sqes_;
+      size_t sqes_size_;
+      uint32 *cq_head_;
+      uint32 *cq_tail_;
+      uint32 cq_mask_;
+      io_uring_cqe *cqes_;
+
+      io_uring_buf *buffers_;
+      size_t buffers_size_;
+      uint8 *memory_;
+      uint16 buffer_tail_;
+      uint32 to_submit_;
+
+      msghdr receive_header_;
+      bool receive_armed_;
+
+      // note: buffers of completed receives not yet handed out
+      uint16 ready_ids_[buffer_count];
+      uint32 ready_head_;
+      uint32 ready_tail_;
+
+      // note: buffers handed out by the last recv_batch
+      uint16 handed_[buffer_count];
+      uint32 handed_count_;
+
+      msghdr send_headers_[queue_depth];
+      iovec send_vectors_[queue_depth];
+      sockaddr_in send_names_[queue_depth];
+      uint32 sends_inflight_;
+      uint32 sends_failed_;
+   };
+
+   bool socket_engine::ring::create(int socket, socket_stats &stats) {
+      socket_ = socket;
+      stats_ = &stats;
+
+      // note: every provided buffer can complete before it is reaped, plus
+      //       a full queue of sends
+      io_uring_params params;
+      memset(&params, 0, sizeof(params));
+      params.flags = IORING_SETUP_CQSIZE;
+      params.cq_entries = 2 * (buffer_count + queue_depth);
+      fd_ = ring_setup(queue_depth, &params);
+      if (fd_ < 0) {
+         return false;
+      }
+
+      sq_map_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32);
+      cq_map_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+      const bool single_map = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+      if (single_map) {
+         sq_map_size_ = sq_map_size_ > cq_map_size_ ? sq_map_size_ : cq_map_size_;
+         cq_map_size_ = sq_map_size_;
+      }
+
+      void *sq = mmap(nullptr, sq_map_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+      if (sq == MAP_FAILED) {
+         return false;
+      }
+      sq_map_ = (uint8 *)sq;
+
+      if (single_map) {
+         cq_map_ = sq_map_;
+      }
+      else {
+         void *cq = mmap(nullptr, cq_map_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+         if (cq == MAP_FAILED) {
+            return false;
+         }
+         cq_map_ = (uint8 *)cq;
+      }
+
+      sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+      void *sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+      if (sqes == MAP_FAILED) {
+         sqes_ = nullptr;
+         return false;
+      }
+      sqes_ = (io_uring_sqe *)sqes;
+
+      sq_head_ = (uint32 *)(sq_map_ + params.sq_off.head);
+      sq_tail_ = (uint32 *)(sq_map_ + params.sq_off.tail);
+      sq_mask_ = *(uint32 *)(sq_map_ + params.sq_off.ring_mask);
+      sq_entries_ = params.sq_entries;
+      sq_array_ = (uint32 *)(sq_map_ + params.sq_off.array);
+      cq_head_ = (uint32 *)(cq_map_ + params.cq_off.head);
+      cq_tail_ = (uint32 *)(cq_map_ + params.cq_off.tail);
+      cq_mask_ = *(uint32 *)(cq_map_ + params.cq_off.ring_mask);
+      cqes_ = (io_uring_cqe *)(cq_map_ + params.cq_off.cqes);
+
+      // note: the provided buffer ring has to be page aligned
+      buffers_size_ = buffer_count * sizeof(io_uring_buf);
+      void *buffers = mmap(nullptr, buffers_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (buffers == MAP_FAILED) {
+         return false;
+      }
+      buffers_ = (io_uring_buf *)buffers;
+
+      io_uring_buf_reg registration;
+      memset(&registration, 0, sizeof(registration));
+      registration.ring_addr = (uint64)(uintptr_t)buffers_;
+      registration.ring_entries = buffer_count;
+      registration.bgid = buffer_group;
+      if (ring_register(fd_, IORING_REGISTER_PBUF_RING, &registration, 1) < 0) {
+         return false;
+      }
+
+      memory_ = new uint8[(uint64)buffer_count * buffer_size];
+      for (uint32 index = 0; index < buffer_count; index++) {
+         recycle((uint16)index);
+      }
+      publish_buffers();
+
+      // note: the kernel lays out every buffer as header, name, payload
+      receive_header_.msg_namelen = sizeof(sockaddr_in);
+      arm_receive();
+
+      return submit(0);
+   }
+
+   void socket_engine::ring::destroy() {
+      // note: closing the ring cancels the multishot receive
+      if (fd_ >= 0) {
+         ::close(fd_);
+         fd_ = -1;
+      }
+      if (buffers_) {
+         munmap(buffers_, buffers_size_);
+         buffers_ = nullptr;
+      }
+      if (sqes_) {
+         munmap(sqes_, sqes_size_);
+         sqes_ = nullptr;
+      }
+      if (cq_map_ && cq_map_ != sq_map_) {
+         munmap(cq_map_, cq_map_size_);
+      }
+      cq_map_ = nullptr;
+      if (sq_map_) {
+         munmap(sq_map_, sq_map_size_);
+         sq_map_ = nullptr;
+      }
+
+      delete[] memory_;
+      memory_ = nullptr;
+   }
+
+   io_uring_sqe *socket_engine::ring::next_sqe() {
+      const uint32 head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+      const uint32 tail = *sq_tail_ + to_submit_;
+      if (tail - head >= sq_entries_) {
+         return nullptr;
+      }
+
+      const uint32 slot = tail & sq_mask_;
+      io_uring_sqe *sqe = &sqes_[slot];
+      memset(sqe, 0, sizeof(io_uring_sqe));
+      sq_array_[slot] = slot;
+      to_submit_++;
+
+      return sqe;
+   }
+
+   bool socket_engine::ring::submit(uint32 wait) {
+      if (to_submit_ > 0) {
+         __atomic_store_n(sq_tail_, *sq_tail_ + to_submit_, __ATOMIC_RELEASE);
+      }
+      if (to_submit_ == 0 && wait == 0) {
+         return true;
+      }
+
+      const uint32 count = to_submit_;
+      to_submit_ = 0;
+      for (;;) {
+         const int result = ring_enter(fd_, count, wait, wait > 0 ? IORING_ENTER_GETEVENTS : 0);
+         if (result >= 0) {
+            return true;
+         }
+         if (errno != EINTR) {
+            return false;
+         }
+      }
+   }
+
+   void socket_engine::ring::arm_receive() {
+      io_uring_sqe *sqe = next_sqe();
+      if (!sqe) {
+         return;
+      }
+
+      sqe->opcode = IORING_OP_RECVMSG;
+      sqe->fd = socket_;
+      sqe->addr = (uint64)(uintptr_t)&receive_header_;
+      sqe->len = 1;
+      sqe->flags = IOSQE_BUFFER_SELECT;
+      sqe->buf_group = buffer_group;
+      sqe->ioprio = IORING_RECV_MULTISHOT;
+      sqe->user_data = receive_tag;
+      receive_armed_ = true;
+   }
+
+   void socket_engine::ring::recycle(uint16 id) {
+      io_uring_buf &buffer = buffers_[buffer_tail_ & (buffer_count - 1)];
+      buffer.addr = (uint64)(uintptr_t)(memory_ + (uint64)id * buffer_size);
+      buffer.len = buffer_size;
+      buffer.bid = id;
+      buffer_tail_++;
+   }
+
+   void socket_engine::ring::publish_buffers() {
+      // note: the tail shares its spot with the reserved field of the first
+      //       entry. the header's flexible array member sits at a different
+      //       offset when compiled as c++, so the entries are addressed directly
+      __atomic_store_n(&buffers_[0].resv, buffer_tail_, __ATOMIC_RELEASE);
+   }
+
+   void socket_engine::ring::reap() {
+      uint32 head = *cq_head_;
+      const uint32 tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+      bool recycled = false;
+      while (head != tail) {
+         const io_uring_cqe &cqe = cqes_[head & cq_mask_];
+         if (cqe.user_data == receive_tag) {
+            if (cqe.flags & IORING_CQE_F_BUFFER) {
+               const uint16 id = (uint16)(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+               if (cqe.res >= (int32)sizeof(io_uring_recvmsg_out)) {
+                  ready_ids_[ready_tail_++ % buffer_count] = id;
+               }
+               else {
+                  recycle(id);
+                  recycled = true;
+               }
+            }
+
+            // note: out of buffers or an error ends the multishot, it is
+            //       armed again on the next recv_batch
+            if (!(cqe.flags & IORING_CQE_F_MORE)) {
+               receive_armed_ = false;
+            }
+            if (cqe.res < 0) {
+               record_error(-cqe.res);
+            }
+         }
+         else {
+            sends_inflight_--;
+            if (cqe.res < 0) {
+               sends_failed_++;
+               record_error(-cqe.res);
+            }
+            else {
+               stats_->on_sent((uint64)cqe.res);
+            }
+         }
+         head++;
+      }
+
+      __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+      if (recycled) {
+         publish_buffers();
+      }
+   }
+
+   void socket_engine::ring::record_error(int code) {
+      // note: completions carry the errno instead of setting it
+      errno = code;
+      stats_->on_error(network::error::get_error());
+   }
+
+   bool socket_engine::ring::has_completions() const {
+      return *cq_head_ != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+   }
+#endif
+
+   namespace {
+      bool poll_handle(uint32 handle, int64 timeout_ms) {
+#if defined(_WIN32)
+         WSAPOLLFD descriptor = {};
+         descriptor.fd = (SOCKET)handle;
+         descriptor.events = POLLRDNORM;
+         return WSAPoll(&descriptor, 1, (INT)timeout_ms) > 0;
+#else
+         pollfd descriptor = {};
+         descriptor.fd = (int)handle;
+         descriptor.events = POLLIN;
+         return poll(&descriptor, 1, (int)timeout_ms) > 0;
+#endif
+      }
+   } // !anon
+
+   socket_engine::socket_engine()
+      : socket_(nullptr)
+      , backend_(BACKEND_NONE)
+      , ring_(nullptr)
+   {
+   }
+
+   socket_engine::~socket_engine() {
+      close();
+   }
+
+   bool socket_engine::is_valid() const {
+      return backend_ != BACKEND_NONE;
+   }
+
+   bool socket_engine::open(udp_socket &socket, const uint32 flags) {
+      if (is_valid() || !socket.is_valid()) {
+         return false;
+      }
+
+      socket_ = &socket;
+      backend_ = BACKEND_POLL;
+
+#if defined(__linux__)
+      if ((flags & OPEN_POLL) == 0) {
+         ring_ = new ring;
+         if (ring_->create((int)socket.handle_, socket.stats_)) {
+            backend_ = BACKEND_IO_URING;
+         }
+         else {
+            ring_->destroy();
+            delete ring_;
+            ring_ = nullptr;
+         }
+      }
+#endif
+
+      return true;
+   }
+
+   void socket_engine::close() {
+#if defined(__linux__)
+      if (ring_) {
+         ring_->destroy();
+         delete ring_;
+         ring_ = nullptr;
+      }
+#endif
+      socket_ = nullptr;
+      backend_ = BACKEND_NONE;
+   }
+
+   const char *socket_engine::backend_name() const {
+      switch (backend_) {
+         case BACKEND_POLL:
+            return "poll";
+         case BACKEND_IO_URING:
+            return "io_uring";
+         default:
+            return "none";
+      }
+   }
+
+   bool socket_engine::wait(int64 timeout_ms) {
+      if (!is_valid()) {
+         return false;
+      }
+
+#if defined(__linux__)
+      if (ring_) {
+         if (ring_->ready_head_ != ring_->ready_tail_ || ring_->has_completions()) {
+            return true;
+         }
+
+         // note: the ring descriptor turns readable once a completion is posted
+         return poll_handle((uint32)ring_->fd_, timeout_ms);
+      }
+#endif
+
+      return poll_handle(socket_->handle_, timeout_ms);
+   }
+
+   bool socket_engine::send_batch(const uint32 count, const ip_address *addresses, byte_stream *streams, uint32 &sent) {
+      sent = 0;
+      if (!is_valid()) {
+         return false;
+      }
+
+#if defined(__linux__)
+      if (ring_) {
+         ring &r = *ring_;
+         while (sent < count) {
+            const uint32 batch = (count - sent) < queue_depth ? (count - sent) : queue_depth;
+            for (uint32 index = 0; index < batch; index++) {
+               const ip_address &address = addresses[sent + index];
+               sockaddr_in &name = r.send_names_[index];
+               memset(&name, 0, sizeof(name));
+               name.sin_family = AF_INET;
+               name.sin_addr.s_addr = htonl(address.host_);
+               name.sin_port = htons(address.port_);
+
+               iovec &vector = r.send_vectors_[index];
+               vector.iov_base = streams[sent + index].base_;
+               vector.iov_len = (size_t)streams[sent + index].length();
+
+               msghdr &header = r.send_headers_[index];
+               memset(&header, 0, sizeof(header));
+               header.msg_name = &name;
+               header.msg_namelen = sizeof(sockaddr_in);
+               header.msg_iov = &vector;
+               header.msg_iovlen = 1;
+
+               io_uring_sqe *sqe = r.next_sqe();
+               if (!sqe) {
+                  return false;
+               }
+               sqe->opcode = IORING_OP_SENDMSG;
+               sqe->fd = (int)socket_->handle_;
+               sqe->addr = (uint64)(uintptr_t)&header;
+               sqe->len = 1;
+               sqe->user_data = index;
+            }
+
+            // note: one enter submits the whole batch, the headers above
+            //       have to outlive it so wait for every send to complete
+            r.sends_inflight_ += batch;
+            r.sends_failed_ = 0;
+            if (!r.submit(batch)) {
+               return false;
+            }
+            r.reap();
+            while (r.sends_inflight_ > 0) {
+               if (!r.submit(1)) {
+                  return false;
+               }
+               r.reap();
+            }
+
+            if (r.sends_failed_ == batch) {
+               return false;
+            }
+            sent += batch;
+         }
+
+         return true;
+      }
+#endif
+
+      return socket_->send_batch(count, addresses, streams, sent);
+   }
+
+   bool socket_engine::recv_batch(const uint32 count, ip_address *addresses, byte_stream *streams, uint32 &received) {
+      received = 0;
+      if (!is_valid()) {
+         return false;
+      }
+
+#if defined(__linux__)
+      if (ring_) {
+         ring &r = *ring_;
+
+         // note: the previous batch has been read, its buffers go back
+         for (uint32 index = 0; index < r.handed_count_; index++) {
+            r.recycle(r.handed_[index]);
+         }
+         if (r.handed_count_ > 0) {
+            r.publish_buffers();
+         }
+         r.handed_count_ = 0;
+
+         r.reap();
+         if (!r.receive_armed_) {
+            r.arm_receive();
+            r.submit(0);
+         }
+
+         while (received < count && r.ready_head_ != r.ready_tail_) {
+            const uint16 id = r.ready_ids_[r.ready_head_++ % buffer_count];
+            uint8 *buffer = r.memory_ + (uint64)id * buffer_size;
+            const io_uring_recvmsg_out *out = (const io_uring_recvmsg_out *)buffer;
+            const sockaddr_in *name = (const sockaddr_in *)(out + 1);
+            uint8 *payload = (uint8 *)(out + 1) + r.receive_header_.msg_namelen + r.receive_header_.msg_controllen;
+            if ((out->flags & MSG_TRUNC) || out->namelen < sizeof(sockaddr_in)) {
+               r.stats_->on_error(NETERR_MESSAGE_TOO_LONG);
+               r.recycle(id);
+               r.publish_buffers();
+               continue;
+            }
+
+            addresses[received] = ip_address(ntohl(name->sin_addr.s_addr), ntohs(name->sin_port));
+            streams[received] = byte_stream(out->payloadlen, payload);
+            streams[received].at_ = payload + out->payloadlen;
+            r.stats_->on_received(out->payloadlen);
+            r.handed_[r.handed_count_++] = id;
+            received++;
+         }
+
+         return received > 0;
+      }
+#endif
+
+      return socket_->recv_batch(count, addresses, streams, received);
+   }
+} // !gamma
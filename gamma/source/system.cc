@@ -2,9 +2,12 @@
 
 #include "gamma.h"
 
+#if defined(_WIN32)
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
+#endif
 #include <stdarg.h>
+#include <stdio.h>
 
 namespace gamma {
    namespace system {
@@ -12,9 +15,15 @@ namespace gamma {
          char message[2048] = {};
          va_list args;
          va_start(args, format);
-         vsprintf_s(message, sizeof(message), format, args);
+         vsnprintf(message, sizeof(message), format, args);
          va_end(args);
+#if defined(_WIN32) && !defined(GAMMA_HEADLESS)
          return MessageBoxA(NULL, message, "Info", MB_OKCANCEL | MB_ICONINFORMATION) == IDOK;
+#else
+         // note: no one to press ok, report and answer cancel
+         fprintf(stderr, "%s\n", message);
+         return false;
+#endif
       }
    } // !system
 } // !uu
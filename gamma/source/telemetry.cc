@@ -0,0 +1,253 @@
+// telemetry.cc
+
+#include "gamma.h"
+
+#include <stdio.h>
+
+namespace gamma {
+   namespace {
+      uint32 bucket_of(int64 value) {
+         uint32 bucket = 0;
+         while (value > 0 && bucket < histogram::bucket_count - 1) {
+            value >>= 1;
+            bucket++;
+         }
+         return bucket;
+      }
+
+      uint64 load(const std::atomic<uint64> &counter) {
+         return counter.load(std::memory_order_relaxed);
+      }
+
+      void clear(std::atomic<uint64> &counter) {
+         counter.store(0, std::memory_order_relaxed);
+      }
+   } // !anon
+
+   uint64 histogram::snapshot::count() const {
+      uint64 result = 0;
+      for (uint32 index = 0; index < bucket_count; index++) {
+         result += buckets_[index];
+      }
+      return result;
+   }
+
+   int64 histogram::snapshot::percentile(double fraction) const {
+      const uint64 total = count();
+      if (total == 0) {
+         return 0;
+      }
+
+      const uint64 target = (uint64)(fraction * (double)(total - 1)) + 1;
+      uint64 seen = 0;
+      for (uint32 index = 0; index < bucket_count; index++) {
+         seen += buckets_[index];
+         if (seen >= target) {
+            return index == 0 ? 0 : ((int64)1 << index) - 1;
+         }
+      }
+      return ((int64)1 << (bucket_count - 1)) - 1;
+   }
+
+   histogram::histogram() {
+      reset();
+   }
+
+   void histogram::reset() {
+      for (auto &bucket : buckets_) {
+         clear(bucket);
+      }
+   }
+
+   void histogram::record(int64 value) {
+      telemetry_add(buckets_[bucket_of(value)], 1);
+   }
+
+   void histogram::read(snapshot &result) const {
+      for (uint32 index = 0; index < bucket_count; index++) {
+         result.buckets_[index] = load(buckets_[index]);
+      }
+   }
+
+   socket_stats::socket_stats() {
+      reset();
+   }
+
+   void socket_stats::reset() {
+      clear(packets_in_);
+      clear(bytes_in_);
+      clear(packets_out_);
+      clear(bytes_out_);
+      clear(would_block_);
+      for (auto &error : errors_) {
+         clear(error);
+      }
+   }
+
+   void socket_stats::on_received(uint64 bytes) {
+      telemetry_add(packets_in_, 1);
+      telemetry_add(bytes_in_, bytes);
+   }
+
+   void socket_stats::on_sent(uint64 bytes) {
+      telemetry_add(packets_out_, 1);
+      telemetry_add(bytes_out_, bytes);
+   }
+
+   void socket_stats::on_error(network_error_code code) {
+      if (code == NETERR_WOULD_BLOCK || code == NETERR_TRY_AGAIN) {
+         telemetry_add(would_block_, 1);
+         return;
+      }
+
+      telemetry_add(errors_[code <= NETERR_UNKNOWN ? code : NETERR_UNKNOWN], 1);
+   }
+
+   void socket_stats::read(snapshot &result) const {
+      result.packets_in_ = load(packets_in_);
+      result.bytes_in_ = load(bytes_in_);
+      result.packets_out_ = load(packets_out_);
+      result.bytes_out_ = load(bytes_out_);
+      result.would_block_ = load(would_block_);
+      for (uint32 index = 0; index <= NETERR_UNKNOWN; index++) {
+         result.errors_[index] = load(errors_[index]);
+      }
+   }
+
+   connection_stats::connection_stats() {
+      reset();
+   }
+
+   void connection_stats::reset() {
+      clear(packets_sent_);
+      clear(bytes_sent_);
+      clear(packets_received_);
+      clear(bytes_received_);
+      clear(packets_acked_);
+      clear(packets_lost_);
+      clear(malformed_);
+      clear(duplicates_);
+      clear(out_of_order_);
+      rtt_.reset();
+      interval_.reset();
+   }
+
+   void connection_stats::read(snapshot &result) const {
+      result.packets_sent_ = load(packets_sent_);
+      result.bytes_sent_ = load(bytes_sent_);
+      result.packets_received_ = load(packets_received_);
+      result.bytes_received_ = load(bytes_received_);
+      result.packets_acked_ = load(packets_acked_);
+      result.packets_lost_ = load(packets_lost_);
+      result.malformed_ = load(malformed_);
+      result.duplicates_ = load(duplicates_);
+      result.out_of_order_ = load(out_of_order_);
+      rtt_.read(result.rtt_);
+      interval_.read(result.interval_);
+   }
+
+   telemetry_log::telemetry_log()
+      : file_(nullptr)
+      , interval_ms_(1000)
+      , next_(0)
+   {
+   }
+
+   telemetry_log::~telemetry_log() {
+      close();
+   }
+
+   bool telemetry_log::open(const char *path, int64 interval_ms) {
+      close();
+
+      file_ = fopen(path, "a");
+      if (!file_) {
+         return false;
+      }
+
+      interval_ms_ = interval_ms > 0 ? interval_ms : 1000;
+      next_ = 0;
+      return true;
+   }
+
+   void telemetry_log::close() {
+      if (file_) {
+         fclose((FILE *)file_);
+         file_ = nullptr;
+      }
+   }
+
+   bool telemetry_log::is_open() const {
+      return file_ != nullptr;
+   }
+
+   bool telemetry_log::is_due(const time &now) {
+      if (!file_ || now.tick_ < next_) {
+         return false;
+      }
+
+      next_ = now.tick_ + interval_ms_;
+      return true;
+   }
+
+   void telemetry_log::write(const time &now, const char *name, const socket_stats &stats) {
+      if (!file_) {
+         return;
+      }
+
+      socket_stats::snapshot values;
+      stats.read(values);
+
+      FILE *file = (FILE *)file_;
+      fprintf(file, "%lld %s packets_in=%llu bytes_in=%llu packets_out=%llu bytes_out=%llu would_block=%llu",
+              (long long)now.tick_, name,
+              (unsigned long long)values.packets_in_, (unsigned long long)values.bytes_in_,
+              (unsigned long long)values.packets_out_, (unsigned long long)values.bytes_out_,
+              (unsigned long long)values.would_block_);
+      for (uint32 index = 0; index <= NETERR_UNKNOWN; index++) {
+         if (values.errors_[index] > 0) {
+            fprintf(file, " %s=%llu", network::error::as_string((network_error_code)index),
+                    (unsigned long long)values.errors_[index]);
+         }
+      }
+      fprintf(file, "\n");
+   }
+
+   void telemetry_log::write(const time &now, const char *name, uint32 id, const connection_stats &stats) {
+      if (!file_) {
+         return;
+      }
+
+      connection_stats::snapshot values;
+      stats.read(values);
+
+      FILE *file = (FILE *)file_;
+      fprintf(file, "%lld %s.%u packets_out=%llu bytes_out=%llu packets_in=%llu bytes_in=%llu acked=%llu lost=%llu"
+              " malformed=%llu duplicates=%llu out_of_order=%llu",
+              (long long)now.tick_, name, id,
+              (unsigned long long)values.packets_sent_, (unsigned long long)values.bytes_sent_,
+              (unsigned long long)values.packets_received_, (unsigned long long)values.bytes_received_,
+              (unsigned long long)values.packets_acked_, (unsigned long long)values.packets_lost_,
+              (unsigned long long)values.malformed_, (unsigned long long)values.duplicates_,
+              (unsigned long long)values.out_of_order_);
+
+      // note: percentiles for reading, raw buckets for plotting
+      const histogram::snapshot *histograms[] = { &values.rtt_, &values.interval_ };
+      const char *names[] = { "rtt", "interval" };
+      for (uint32 index = 0; index < 2; index++) {
+         const histogram::snapshot &h = *histograms[index];
+         fprintf(file, " %s_p50=%lld %s_p99=%lld %s=", names[index], (long long)h.percentile(0.5),
+                 names[index], (long long)h.percentile(0.99), names[index]);
+         for (uint32 bucket = 0; bucket < histogram::bucket_count; bucket++) {
+            fprintf(file, bucket == 0 ? "%llu" : ",%llu", (unsigned long long)h.buckets_[bucket]);
+         }
+      }
+      fprintf(file, "\n");
+   }
+
+   void telemetry_log::flush() {
+      if (file_) {
+         fflush((FILE *)file_);
+      }
+   }
+} // !gamma
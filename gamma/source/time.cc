@@ -2,26 +2,52 @@
 
 #include "gamma.h"
 
+#if defined(_WIN32)
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
+#else
+#include <time.h>
+#endif
 
 namespace gamma {
+   namespace {
+      // note: the start point is taken by a function local static, the
+      //       first call to time::now can come from any server worker
+#if defined(_WIN32)
+      struct performance_clock {
+         performance_clock() {
+            LARGE_INTEGER f = {};
+            QueryPerformanceFrequency(&f);
+            factor_ = f.QuadPart / 1000;
+            QueryPerformanceCounter(&start_);
+         }
+
+         LARGE_INTEGER start_;
+         int64 factor_;
+      };
+#else
+      int64 monotonic_ms() {
+         timespec now = {};
+         clock_gettime(CLOCK_MONOTONIC, &now);
+         return (int64)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+      }
+#endif
+   } // !anon
+
    // static
    time time::now() {
-      static LARGE_INTEGER start = {};
-      static int64 factor = 0;
-      if (!factor)
-      {
-         LARGE_INTEGER f = {};
-         QueryPerformanceFrequency(&f);
-         factor = f.QuadPart / 1000;
-         QueryPerformanceCounter(&start);
-      }
+#if defined(_WIN32)
+      static const performance_clock counter;
 
       LARGE_INTEGER now = {};
       QueryPerformanceCounter(&now);
 
-      return time((now.QuadPart - start.QuadPart) / factor);
+      return time((now.QuadPart - counter.start_.QuadPart) / counter.factor_);
+#else
+      static const int64 start = monotonic_ms();
+
+      return time(monotonic_ms() - start);
+#endif
    }
 
    time::time()
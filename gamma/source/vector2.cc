@@ -2,7 +2,10 @@
 
 #include "gamma.h"
 
+// note: glibc math.h declares a gamma() function that collides with the namespace
+#define gamma gamma_libm
 #include <math.h>
+#undef gamma
 
 namespace gamma {
    vector2::vector2()
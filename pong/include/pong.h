@@ -74,7 +74,7 @@ namespace uu {
       bool enter() { return true; }
       void exit() {}
       bool update(const time &dt, const keyboard &kb);
-      void render(render_system &rs);
+      void render(render_system &rs, float alpha);
 
       state state_;
       udp_socket socket_;
@@ -5,7 +5,7 @@
 #include "pong.h"
 
 namespace gamma {
-   game_base *create_game(string &caption, video_mode &mode) {
+   game_base *create_game(const char *, string &caption, video_mode &mode) {
       caption = "PONG";
       mode = video_mode(1280, 720);
       return new uu::pong(1280.0f, 720.0f);
@@ -138,7 +138,7 @@ namespace uu {
       return true;
    }
 
-   void pong::render(render_system &rs) {
+   void pong::render(render_system &rs, float alpha) {
       rs.clear();
       ball_.render(rs);
       local_.render(rs);
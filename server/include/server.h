@@ -0,0 +1,260 @@
+// server.h
+
+#ifndef SERVER_H_INCLUDED
+#define SERVER_H_INCLUDED
+
+#include <gamma.h>
+
+using namespace gamma;
+
+#include <atomic>
+
+#include "match.h"
+#include "messages.h"
+#include "snapshot.h"
+
+namespace uu {
+   constexpr uint32 invalid_index = ~0u;
+
+   // note: flat open addressing table from a peer address (host and port)
+   //       to a session index. linear probing over a power of two sized
+   //       array, erase shifts the following entries back so lookups never
+   //       have to skip tombstones
+   struct session_table {
+      session_table();
+      ~session_table();
+      session_table(const session_table &) = delete;
+      session_table &operator=(const session_table &) = delete;
+
+      bool create(uint32 max_entries);
+      void destroy();
+
+      uint32 find(const ip_address &address) const;
+      bool insert(const ip_address &address, uint32 value);
+      bool erase(const ip_address &address);
+      uint32 size() const;
+
+      struct slot {
+         uint64 key_;
+         uint32 value_;
+      };
+
+      uint32 mask_;
+      uint32 count_;
+      slot *slots_;
+   };
+
+   // note: issues and checks the cookies of the handshake, see
+   //       message_handshake. reset draws a new key, voiding older cookies
+   struct handshake_cookies {
+      static constexpr uint32 lifetime_s = 10;
+
+      handshake_cookies();
+
+      void reset();
+      message_handshake challenge(const ip_address &address, const time &now) const;
+      bool verify(const ip_address &address, uint32 issued, uint64 cookie, const time &now) const;
+      uint64 cookie_of(const ip_address &address, uint32 issued) const;
+
+      uint64 key_[2];
+   };
+
+   // note: the peers subscribed to a stream. subscribing again refreshes a
+   //       peer, the ones quiet for timeout_ms are dropped. addresses are
+   //       kept dense for the fan-out, the table finds a peer's slot
+   struct spectator_list {
+      static constexpr int64 timeout_ms = 5000;
+      static constexpr int64 expire_interval_ms = 1000;
+
+      spectator_list();
+      spectator_list(const spectator_list &) = delete;
+      spectator_list &operator=(const spectator_list &) = delete;
+
+      bool create(uint32 max_spectators);
+      void destroy();
+
+      bool subscribe(const ip_address &address, const time &now);
+      void expire(const time &now);
+      uint32 size() const;
+
+      // note: returns false unless every spectator got the datagram
+      bool send(udp_socket &socket, const byte_stream &stream);
+
+      session_table table_;
+      uint32 max_spectators_;
+      int64 next_expire_;
+      dynamic_array<ip_address> addresses_;
+      dynamic_array<int64> last_seen_;
+   };
+
+   // note: the spectator stream of one match. each tick the match is
+   //       captured, the capture delay_ticks old is encoded once and the
+   //       same bytes go to every spectator. a keyframe against the empty
+   //       snapshot every keyframe_ticks, the ticks in between are deltas
+   //       against the last keyframe, a spectator that lost one only waits
+   //       for the next keyframe
+   struct spectator_feed {
+      static constexpr uint32 delay_ticks = 30;
+      static constexpr uint32 keyframe_ticks = 16;
+      static_assert(delay_ticks < snapshot_ring::capacity, "The delayed tick must still be in the history");
+
+      spectator_feed();
+
+      bool create(uint32 max_spectators);
+      void update(const match &m, udp_socket &socket, const time &now);
+
+      uint32 tick_;
+      uint32 keyframe_tick_;
+      snapshot_ring history_;
+      snapshot_ring keyframes_;
+      spectator_list spectators_;
+      uint8 buffer_[packet_builder::mtu];
+   };
+
+   struct session {
+      session();
+
+      bool is_active() const;
+
+      ip_address address_;
+      connection connection_;
+      clock_sync clock_;
+      rate_controller rate_;
+      int64 last_received_;
+      uint32 match_;
+      match_side side_;
+      uint32 remote_input_tick_;
+
+      // note: the opponents inputs not yet acked by this peer, relay_tick_
+      //       is the tick of relay_buffer_.front()
+      std::vector<input> relay_buffer_;
+      uint32 relay_tick_;
+      uint32 sent_relay_tick_[connection::packet_window];
+   };
+
+   // note: the match only steps once both sides sent the input for the
+   //       next frame, pending_ holds the inputs of frames not yet run.
+   //       each input carries how many ticks behind the opponent was on
+   //       that peer's screen, its bullets are checked against history_
+   //       that far back
+   struct match_slot {
+      bool active_;
+      uint32 sessions_[MATCH_SIDE_COUNT];
+      uint32 frame_;
+      std::vector<input> pending_[MATCH_SIDE_COUNT];
+      match match_;
+      collider_history history_;
+
+      // note: only allocated once a spectator subscribes
+      spectator_feed *feed_;
+   };
+
+   struct server;
+
+   // note: what the message handlers of a server need to know about the
+   //       stream being walked
+   struct message_context {
+      server *server_;
+      uint32 index_;
+      time now_;
+   };
+
+   // note: headless authoritative host for many matches on a single port.
+   //       datagrams are pulled in with recv_batch, routed to their session
+   //       through the session table and answered with one packet per
+   //       session and tick, pushed out with send_batch. both go through the
+   //       socket engine, wait sleeps on it until datagrams or the next tick.
+   //       unknown peers only get a session once they pass the handshake,
+   //       or a spectator_feed subscription of a running match
+   struct server {
+      static constexpr uint32 batch_size = 64;
+      static constexpr int64 tick_ms = 16;
+      static constexpr uint32 max_catch_up_ticks = 8;
+      static constexpr int64 session_timeout_ms = 5000;
+      static constexpr int64 max_send_interval_ms = 100;
+      static constexpr uint32 session_budget = 16000;
+      static constexpr uint32 max_spectators = 16384;
+
+      server();
+      ~server();
+      server(const server &) = delete;
+      server &operator=(const server &) = delete;
+
+      bool open(uint16 port, uint32 max_sessions, uint32 flags = udp_socket::OPEN_DEFAULT);
+      void close();
+      void update(const time &now);
+      void wait(const time &now);
+
+      // note: appends the socket and session counters to path every
+      //       interval, from the worker thread between two updates
+      bool open_telemetry(const char *path, int64 interval_ms);
+      void write_telemetry(const time &now);
+
+      uint32 session_count() const;
+      uint32 match_count() const;
+      uint64 packets_received() const;
+      uint64 handshakes_rejected() const;
+
+      uint32 create_session(const ip_address &address, const time &now);
+      void destroy_session(uint32 index);
+      void receive(const time &now);
+      void accept_handshake(const ip_address &address, byte_stream &stream, const time &now);
+      void accept_spectator(const ip_address &address, const message_spectate &message, const time &now);
+      void receive_messages(uint32 index, byte_stream &stream, const time &now);
+      void receive_input_buffer(uint32 index, message_input_buffer &message);
+      static bool receive_connection_request(message_context &context, message_connection_request &message);
+      static bool receive_disconnect(message_context &context, message_disconnect &message);
+      static bool receive_input(message_context &context, message_input &message);
+      static bool receive_input_buffer(message_context &context, message_input_buffer &message);
+      static bool receive_ping(message_context &context, message_ping &message);
+      static bool receive_pong(message_context &context, message_pong &message);
+      void start_match(uint32 left, uint32 right);
+      void end_match(uint32 index);
+      void tick(const time &now);
+      void send(const time &now);
+      bool flush_batch(ip_address *addresses, byte_stream *streams, uint32 &count);
+
+      udp_socket socket_;
+      socket_engine engine_;
+      message_dispatcher<message_context> dispatcher_;
+      texture texture_;
+      sprite_sheet sprite_sheet_;
+      session_table table_;
+      uint32 max_sessions_;
+      std::atomic<uint32> session_count_;
+      session *sessions_;
+      dynamic_array<uint32> free_sessions_;
+      std::atomic<uint32> match_count_;
+      match_slot *matches_;
+      dynamic_array<uint32> free_matches_;
+      uint32 waiting_;
+      int64 next_tick_;
+      std::atomic<uint64> packets_received_;
+      std::atomic<uint64> handshakes_rejected_;
+      handshake_cookies cookies_;
+      telemetry_log telemetry_;
+
+      uint8 receive_buffer_[batch_size][packet_builder::mtu];
+      byte_stream receive_streams_[batch_size];
+      ip_address receive_addresses_[batch_size];
+      uint8 send_buffer_[batch_size][packet_builder::mtu];
+      byte_stream send_streams_[batch_size];
+      ip_address send_addresses_[batch_size];
+
+      // note: challenges answered during one receive, kept apart from the
+      //       send buffers since a handler may send on those meanwhile
+      uint8 challenge_buffer_[batch_size][handshake_size];
+      byte_stream challenge_streams_[batch_size];
+      ip_address challenge_addresses_[batch_size];
+      uint32 challenge_count_;
+
+      // note: disconnects of matches that ended, written when the match
+      //       ends and sent once the batch being built has gone out
+      uint8 disconnect_buffer_[batch_size][packet_builder::mtu];
+      byte_stream disconnect_streams_[batch_size];
+      ip_address disconnect_addresses_[batch_size];
+      uint32 disconnect_count_;
+   };
+} // !uu
+
+#endif // !SERVER_H_INCLUDED
@@ -0,0 +1,54 @@
+// server_pool.h
+
+#ifndef SERVER_POOL_H_INCLUDED
+#define SERVER_POOL_H_INCLUDED
+
+#include "server.h"
+
+// note: <thread> drags in ::time, which clashes with gamma::time for every
+//       header that uses it unqualified, so it has to come last
+#include <thread>
+
+namespace uu {
+   // note: one server per worker thread, all bound to the same port with
+   //       SO_REUSEPORT. every worker owns a disjoint set of sessions and
+   //       matches, the reuse port program keeps each peer on the worker
+   //       that owns its session so workers never share state
+   struct server_pool {
+      static constexpr uint32 max_workers = 64;
+
+      server_pool();
+      ~server_pool();
+      server_pool(const server_pool &) = delete;
+      server_pool &operator=(const server_pool &) = delete;
+
+      // note: max_sessions is split evenly between the workers. port 0
+      //       binds the first worker to any free port, the rest follow it
+      bool open(uint16 port, uint32 max_sessions, uint32 worker_count);
+      void close();
+
+      // note: call before start, with several workers each one writes
+      //       its own file, path suffixed with the worker index
+      bool open_telemetry(const char *path, int64 interval_ms);
+
+      bool start();
+      void stop();
+
+      uint16 port() const;
+      uint32 worker_count() const;
+      uint32 session_count() const;
+      uint32 match_count() const;
+      uint64 packets_received() const;
+      uint64 handshakes_rejected() const;
+      void read_socket_stats(socket_stats::snapshot &result) const;
+
+      void run(uint32 worker);
+
+      std::atomic<bool> running_;
+      uint16 port_;
+      dynamic_array<server *> workers_;
+      dynamic_array<std::thread> threads_;
+   };
+} // !uu
+
+#endif // !SERVER_POOL_H_INCLUDED
@@ -0,0 +1,73 @@
+// spectator_relay.h
+
+#ifndef SPECTATOR_RELAY_H_INCLUDED
+#define SPECTATOR_RELAY_H_INCLUDED
+
+#include "server.h"
+
+namespace uu {
+   // note: the subscribing end of a spectator stream. sends a handshake
+   //       request, answers the challenge with a spectate and starts over
+   //       every resubscribe_ms, well inside the upstream timeout. a
+   //       request without a challenge is resent after resend_ms, doubled
+   //       on every further miss so a swamped upstream is not made worse
+   struct spectator_link {
+      static constexpr int64 resubscribe_ms = 2000;
+      static constexpr int64 resend_ms = 250;
+      static constexpr int64 max_resend_ms = 2000;
+      static_assert(resubscribe_ms < spectator_list::timeout_ms, "Resubscribe before the upstream drops us");
+
+      spectator_link();
+
+      void reset(const ip_address &upstream, uint32 match);
+      void update(udp_socket &socket, const time &now);
+
+      // note: true if the datagram was the upstream's challenge
+      bool receive(udp_socket &socket, byte_stream &stream, const time &now);
+
+      ip_address upstream_;
+      uint32 match_;
+      int64 subscribed_;
+      int64 requested_;
+      int64 backoff_ms_;
+   };
+
+   // note: a node of the spectator relay tree. it subscribes to a match
+   //       server or another relay like any spectator and forwards every
+   //       snapshot datagram byte for byte to its own spectators, so a
+   //       snapshot is encoded once at the root however deep the tree
+   //       goes. spectators join it through the same cookie handshake. the
+   //       upstream is talked to on a socket of its own, a flood of joins
+   //       cannot crowd out the stream or the challenges of the upstream
+   struct spectator_relay {
+      static constexpr uint32 batch_size = 64;
+
+      spectator_relay();
+      ~spectator_relay();
+      spectator_relay(const spectator_relay &) = delete;
+      spectator_relay &operator=(const spectator_relay &) = delete;
+
+      bool open(uint16 port, const ip_address &upstream, uint32 match, uint32 max_spectators);
+      void close();
+      void update(const time &now);
+      void wait(int64 timeout_ms);
+
+      void receive_upstream(byte_stream &stream, const time &now);
+      void receive(const ip_address &address, byte_stream &stream, const time &now);
+
+      udp_socket upstream_socket_;
+      udp_socket socket_;
+      socket_engine engine_;
+      spectator_link upstream_;
+      spectator_list spectators_;
+      handshake_cookies cookies_;
+      uint64 forwarded_;
+      uint64 handshakes_rejected_;
+
+      uint8 receive_buffer_[batch_size][packet_builder::mtu];
+      byte_stream receive_streams_[batch_size];
+      ip_address receive_addresses_[batch_size];
+   };
+} // !uu
+
+#endif // !SPECTATOR_RELAY_H_INCLUDED
@@ -0,0 +1,37 @@
+// handshake_cookies.cc
+
+#include "server.h"
+
+namespace uu {
+   namespace {
+      uint32 seconds_of(const time &now) {
+         return (uint32)(now.tick_ / 1000);
+      }
+   } // !anon
+
+   handshake_cookies::handshake_cookies() {
+      key_[0] = 0;
+      key_[1] = 0;
+   }
+
+   void handshake_cookies::reset() {
+      hash::random_key(key_);
+   }
+
+   message_handshake handshake_cookies::challenge(const ip_address &address, const time &now) const {
+      const uint32 issued = seconds_of(now);
+      return message_handshake(MESSAGE_HANDSHAKE_CHALLENGE, issued, cookie_of(address, issued));
+   }
+
+   bool handshake_cookies::verify(const ip_address &address, uint32 issued, uint64 cookie, const time &now) const {
+      // note: the cookie only proves the peer can receive at its address,
+      //       it expires so one seen on the wire is not good for long
+      const uint32 age = seconds_of(now) - issued;
+      return age <= lifetime_s && cookie == cookie_of(address, issued);
+   }
+
+   uint64 handshake_cookies::cookie_of(const ip_address &address, uint32 issued) const {
+      const uint64 words[2] = { ((uint64)address.host_ << 16) | address.port_, issued };
+      return hash::siphash(key_, words, sizeof(words));
+   }
+} // !uu
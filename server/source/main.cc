@@ -0,0 +1,136 @@
+// main.cc
+
+// note: ahead of server_pool.h and its <thread>
+#include "spectator_relay.h"
+#include "server_pool.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+namespace {
+   volatile std::sig_atomic_t g_running = 1;
+
+   void on_signal(int) {
+      g_running = 0;
+   }
+
+   // note: relay <port> <upstream host> <upstream port> [match], a node of
+   //       the spectator tree below a match server or another relay
+   int run_relay(int argc, char **argv) {
+      if (argc < 5) {
+         fprintf(stderr, "usage: %s relay <port> <upstream host> <upstream port> [match]\n", argv[0]);
+         return -1;
+      }
+
+      const uint16 port = (uint16)atoi(argv[2]);
+      const uint32 match = argc > 5 ? (uint32)atoi(argv[5]) : uu::invalid_index;
+
+      dynamic_array<ip_address> addresses;
+      if (!ip_address::lookup(argv[3], addresses) || addresses.empty()) {
+         fprintf(stderr, "could not resolve %s\n", argv[3]);
+         return -1;
+      }
+      ip_address upstream = addresses[0];
+      upstream.set_port((uint16)atoi(argv[4]));
+
+      uu::spectator_relay *relay = new uu::spectator_relay;
+      if (!relay->open(port, upstream, match, uu::server::max_spectators)) {
+         auto errcode = network::error::get_error();
+         fprintf(stderr, "could not open relay on port %d: %s\n", port, network::error::as_string(errcode));
+         delete relay;
+         return -1;
+      }
+
+      printf("relaying %s:%d on port %d\n", argv[3], upstream.port_, port);
+
+      gamma::time report = gamma::time::now();
+      while (g_running) {
+         const gamma::time now = gamma::time::now();
+         relay->update(now);
+         if (now.tick_ - report.tick_ >= 10000) {
+            report = now;
+            printf("%u spectators, %llu snapshots forwarded, %llu rejected handshakes\n", relay->spectators_.size(),
+                   (unsigned long long)relay->forwarded_, (unsigned long long)relay->handshakes_rejected_);
+         }
+         relay->wait(uu::spectator_link::resend_ms);
+      }
+
+      delete relay;
+      return 0;
+   }
+} // !anon
+
+int main(int argc, char **argv) {
+   if (argc > 1 && strcmp(argv[1], "relay") == 0) {
+      std::signal(SIGINT, on_signal);
+      std::signal(SIGTERM, on_signal);
+
+      if (!network::init()) {
+         fprintf(stderr, "could not initialize networking\n");
+         return -1;
+      }
+
+      const int result = run_relay(argc, argv);
+      network::shut();
+      return result;
+   }
+
+   const uint16 port = argc > 1 ? (uint16)atoi(argv[1]) : 32100;
+   const uint32 max_sessions = argc > 2 ? (uint32)atoi(argv[2]) : 4096;
+   const uint32 workers = argc > 3 ? (uint32)atoi(argv[3]) : 1;
+   const char *telemetry = argc > 4 ? argv[4] : nullptr;
+
+   std::signal(SIGINT, on_signal);
+   std::signal(SIGTERM, on_signal);
+
+   if (!network::init()) {
+      fprintf(stderr, "could not initialize networking\n");
+      return -1;
+   }
+
+   uu::server_pool *pool = new uu::server_pool;
+   if (!pool->open(port, max_sessions, workers)) {
+      auto errcode = network::error::get_error();
+      fprintf(stderr, "could not open port %d with %u workers: %s\n", port, workers, network::error::as_string(errcode));
+      delete pool;
+      network::shut();
+      return -1;
+   }
+
+   if (telemetry && !pool->open_telemetry(telemetry, 1000)) {
+      fprintf(stderr, "could not open telemetry log %s\n", telemetry);
+   }
+
+   printf("listening on port %d, %u sessions max, %u workers\n", pool->port(), max_sessions, pool->worker_count());
+
+   pool->start();
+
+   gamma::time report = gamma::time::now();
+   while (g_running) {
+      const gamma::time now = gamma::time::now();
+      if (now.tick_ - report.tick_ >= 10000) {
+         report = now;
+         socket_stats::snapshot stats;
+         pool->read_socket_stats(stats);
+         uint64 errors = 0;
+         for (uint64 count : stats.errors_) {
+            errors += count;
+         }
+         printf("%u sessions, %u matches, %llu packets in, %llu packets out, %llu errors, %llu rejected handshakes\n",
+                pool->session_count(), pool->match_count(), (unsigned long long)stats.packets_in_,
+                (unsigned long long)stats.packets_out_, (unsigned long long)errors,
+                (unsigned long long)pool->handshakes_rejected());
+      }
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+   }
+
+   delete pool;
+   network::shut();
+
+   return 0;
+}
@@ -0,0 +1,629 @@
+// server.cc
+
+#include "server.h"
+
+namespace uu {
+   namespace {
+      // note: the match start answer the clients look for
+      constexpr uint32 connection_magic = 666666;
+   } // !anon
+
+   session::session()
+      : last_received_(0)
+      , match_(invalid_index)
+      , side_(MATCH_SIDE_LEFT)
+      , remote_input_tick_(0)
+      , relay_tick_(0)
+   {
+      for (auto &tick : sent_relay_tick_) {
+         tick = 0;
+      }
+   }
+
+   bool session::is_active() const {
+      return last_received_ >= 0;
+   }
+
+   server::server()
+      : sprite_sheet_(texture_)
+      , max_sessions_(0)
+      , session_count_(0)
+      , sessions_(nullptr)
+      , match_count_(0)
+      , matches_(nullptr)
+      , waiting_(invalid_index)
+      , next_tick_(0)
+      , packets_received_(0)
+      , handshakes_rejected_(0)
+      , challenge_count_(0)
+      , disconnect_count_(0)
+   {
+      for (uint32 index = 0; index < batch_size; index++) {
+         receive_streams_[index] = byte_stream(sizeof(receive_buffer_[index]), receive_buffer_[index]);
+         send_streams_[index] = byte_stream(sizeof(send_buffer_[index]), send_buffer_[index]);
+         challenge_streams_[index] = byte_stream(sizeof(challenge_buffer_[index]), challenge_buffer_[index]);
+         disconnect_streams_[index] = byte_stream(sizeof(disconnect_buffer_[index]), disconnect_buffer_[index]);
+      }
+
+      dispatcher_.set<message_connection_request, &server::receive_connection_request>(MESSAGE_CONNECTION_REQUEST);
+      dispatcher_.set<message_disconnect, &server::receive_disconnect>(MESSAGE_DISCONNECT);
+      dispatcher_.set<message_input, &server::receive_input>(MESSAGE_INPUT);
+      dispatcher_.set<message_input_buffer, &server::receive_input_buffer>(MESSAGE_INPUT_BUFFER);
+      dispatcher_.set<message_ping, &server::receive_ping>(MESSAGE_PING);
+      dispatcher_.set<message_pong, &server::receive_pong>(MESSAGE_PONG);
+   }
+
+   server::~server() {
+      close();
+   }
+
+   bool server::open(uint16 port, uint32 max_sessions, uint32 flags) {
+      if (socket_.is_valid()) {
+         return false;
+      }
+
+      ip_address local;
+      local.set_port(port);
+      if (!socket_.open(local, flags)) {
+         return false;
+      }
+
+      if (!engine_.open(socket_)) {
+         socket_.close();
+         return false;
+      }
+
+      if (!table_.create(max_sessions)) {
+         engine_.close();
+         socket_.close();
+         return false;
+      }
+
+      max_sessions_ = max_sessions;
+      sessions_ = new session[max_sessions];
+      matches_ = new match_slot[max_sessions / 2 + 1];
+
+      // note: hand out low indices first
+      free_sessions_.clear();
+      for (uint32 index = max_sessions; index > 0; index--) {
+         sessions_[index - 1].last_received_ = -1;
+         free_sessions_.push_back(index - 1);
+      }
+      free_matches_.clear();
+      for (uint32 index = max_sessions / 2 + 1; index > 0; index--) {
+         matches_[index - 1].active_ = false;
+         matches_[index - 1].feed_ = nullptr;
+         free_matches_.push_back(index - 1);
+      }
+
+      session_count_ = 0;
+      match_count_ = 0;
+      waiting_ = invalid_index;
+      next_tick_ = time::now().tick_;
+      packets_received_ = 0;
+      handshakes_rejected_ = 0;
+      challenge_count_ = 0;
+
+      // note: a new key on every open, cookies of a previous run are void
+      cookies_.reset();
+
+      return true;
+   }
+
+   void server::close() {
+      engine_.close();
+      socket_.close();
+      table_.destroy();
+
+      delete[] sessions_;
+      sessions_ = nullptr;
+      for (uint32 index = 0; matches_ && index < max_sessions_ / 2 + 1; index++) {
+         delete matches_[index].feed_;
+      }
+      delete[] matches_;
+      matches_ = nullptr;
+
+      telemetry_.close();
+      free_sessions_.clear();
+      free_matches_.clear();
+      max_sessions_ = 0;
+      session_count_ = 0;
+      match_count_ = 0;
+      waiting_ = invalid_index;
+   }
+
+   void server::update(const time &now) {
+      receive(now);
+
+      // note: fixed rate simulation, a late frame runs the ticks it missed.
+      //       one that fell further behind than max_catch_up_ticks drops the
+      //       rest and carries on from the next tick due, as the client does
+      uint32 ticks = 0;
+      while (next_tick_ <= now.tick_) {
+         if (ticks == max_catch_up_ticks) {
+            next_tick_ += ((now.tick_ - next_tick_) / tick_ms + 1) * tick_ms;
+            break;
+         }
+
+         tick(now);
+         next_tick_ += tick_ms;
+         ticks++;
+      }
+
+      if (telemetry_.is_due(now)) {
+         write_telemetry(now);
+      }
+   }
+
+   void server::wait(const time &now) {
+      const int64 remaining = next_tick_ - now.tick_;
+      engine_.wait(remaining > 0 ? remaining : 0);
+   }
+
+   bool server::open_telemetry(const char *path, int64 interval_ms) {
+      return telemetry_.open(path, interval_ms);
+   }
+
+   void server::write_telemetry(const time &now) {
+      telemetry_.write(now, "socket", socket_.stats_);
+      for (uint32 index = 0; index < max_sessions_; index++) {
+         const session &s = sessions_[index];
+         if (s.is_active()) {
+            telemetry_.write(now, "session", index, s.connection_.stats_);
+         }
+      }
+      telemetry_.flush();
+   }
+
+   uint32 server::session_count() const {
+      return session_count_;
+   }
+
+   uint32 server::match_count() const {
+      return match_count_;
+   }
+
+   uint64 server::packets_received() const {
+      return packets_received_;
+   }
+
+   uint64 server::handshakes_rejected() const {
+      return handshakes_rejected_;
+   }
+
+   uint32 server::create_session(const ip_address &address, const time &now) {
+      if (free_sessions_.empty()) {
+         return invalid_index;
+      }
+
+      const uint32 index = free_sessions_.back();
+      if (!table_.insert(address, index)) {
+         return invalid_index;
+      }
+      free_sessions_.pop_back();
+
+      session &s = sessions_[index];
+      s.address_ = address;
+      s.connection_.reset();
+      s.clock_.reset();
+      s.rate_.configure(match::tick_ms, max_send_interval_ms, session_budget);
+      s.last_received_ = now.tick_;
+      s.match_ = invalid_index;
+      s.remote_input_tick_ = 0;
+      s.relay_buffer_.clear();
+      s.relay_tick_ = 0;
+      for (auto &tick : s.sent_relay_tick_) {
+         tick = 0;
+      }
+      session_count_++;
+
+      return index;
+   }
+
+   void server::destroy_session(uint32 index) {
+      session &s = sessions_[index];
+      if (!s.is_active()) {
+         return;
+      }
+
+      // note: ending the match destroys the sessions of both sides, this
+      //       one included, there is nothing left to free afterwards
+      if (s.match_ != invalid_index) {
+         end_match(s.match_);
+         if (!s.is_active()) {
+            return;
+         }
+      }
+      if (waiting_ == index) {
+         waiting_ = invalid_index;
+      }
+
+      table_.erase(s.address_);
+      s.last_received_ = -1;
+      s.relay_buffer_.clear();
+      free_sessions_.push_back(index);
+      session_count_--;
+   }
+
+   void server::receive(const time &now) {
+      uint32 received = 0;
+      do {
+         // note: the engine may point the streams at its own buffers
+         for (uint32 packet = 0; packet < batch_size; packet++) {
+            receive_streams_[packet] = byte_stream(sizeof(receive_buffer_[packet]), receive_buffer_[packet]);
+         }
+
+         received = 0;
+         if (!engine_.recv_batch(batch_size, receive_addresses_, receive_streams_, received)) {
+            break;
+         }
+         packets_received_ += received;
+
+         for (uint32 packet = 0; packet < received; packet++) {
+            const ip_address &address = receive_addresses_[packet];
+            const uint32 index = table_.find(address);
+            if (index == invalid_index) {
+               accept_handshake(address, receive_streams_[packet], now);
+               continue;
+            }
+
+            // note: responses the client resent before its first packet
+            //       arrived, they must not reach the connection
+            message_handshake handshake;
+            if (read_handshake(receive_streams_[packet], handshake)) {
+               continue;
+            }
+
+            session &s = sessions_[index];
+            if (!s.connection_.read_packet(now, receive_streams_[packet])) {
+               continue;
+            }
+            s.last_received_ = now.tick_;
+
+            byte_stream message;
+            while (s.is_active() && s.connection_.receive_reliable(message)) {
+               receive_messages(index, message, now);
+            }
+            if (s.is_active()) {
+               receive_messages(index, s.connection_.unreliable_payload(), now);
+            }
+         }
+      } while (received == batch_size);
+
+      flush_batch(challenge_addresses_, challenge_streams_, challenge_count_);
+      flush_batch(disconnect_addresses_, disconnect_streams_, disconnect_count_);
+   }
+
+   void server::accept_handshake(const ip_address &address, byte_stream &stream, const time &now) {
+      // note: everything from an unknown peer that is not a well formed
+      //       handshake is dropped, a request costs a hash and a reply of
+      //       the same size and nothing is kept for it
+      message_spectate spectate;
+      if (read_spectate(stream, spectate)) {
+         accept_spectator(address, spectate, now);
+         return;
+      }
+
+      message_handshake message;
+      if (!read_handshake(stream, message)) {
+         return;
+      }
+
+      if (message.type_ == MESSAGE_HANDSHAKE_REQUEST) {
+         message_handshake challenge = cookies_.challenge(address, now);
+         if (!write_handshake(challenge_streams_[challenge_count_], challenge)) {
+            return;
+         }
+
+         challenge_addresses_[challenge_count_++] = address;
+         if (challenge_count_ == batch_size) {
+            flush_batch(challenge_addresses_, challenge_streams_, challenge_count_);
+         }
+         return;
+      }
+
+      if (message.type_ != MESSAGE_HANDSHAKE_RESPONSE) {
+         return;
+      }
+
+      if (!cookies_.verify(address, message.issued_, message.cookie_, now)) {
+         handshakes_rejected_++;
+         return;
+      }
+
+      create_session(address, now);
+   }
+
+   void server::accept_spectator(const ip_address &address, const message_spectate &message, const time &now) {
+      // note: the cookie matters even more here, without it anyone could
+      //       point the fan-out at an address of their choosing
+      if (!cookies_.verify(address, message.issued_, message.cookie_, now)) {
+         handshakes_rejected_++;
+         return;
+      }
+
+      const uint32 match_slots = max_sessions_ / 2 + 1;
+      uint32 index = message.match_;
+      for (uint32 slot = 0; index == invalid_index && slot < match_slots; slot++) {
+         if (matches_[slot].active_) {
+            index = slot;
+         }
+      }
+      if (index >= match_slots || !matches_[index].active_) {
+         return;
+      }
+
+      match_slot &slot = matches_[index];
+      if (!slot.feed_) {
+         slot.feed_ = new spectator_feed;
+         if (!slot.feed_->create(max_spectators)) {
+            delete slot.feed_;
+            slot.feed_ = nullptr;
+            return;
+         }
+      }
+
+      slot.feed_->spectators_.subscribe(address, now);
+   }
+
+   void server::receive_messages(uint32 index, byte_stream &stream, const time &now) {
+      message_context context = { this, index, now };
+      dispatcher_.dispatch(context, stream);
+   }
+
+   bool server::receive_connection_request(message_context &context, message_connection_request &message) {
+      if (!message.is_valid()) {
+         return false;
+      }
+
+      server &host = *context.server_;
+      const uint32 index = context.index_;
+      if (host.sessions_[index].match_ != invalid_index || host.waiting_ == index) {
+         return true;
+      }
+
+      if (host.waiting_ == invalid_index) {
+         host.waiting_ = index;
+      }
+      else {
+         const uint32 opponent = host.waiting_;
+         host.waiting_ = invalid_index;
+         host.start_match(opponent, index);
+      }
+      return true;
+   }
+
+   bool server::receive_disconnect(message_context &context, message_disconnect &) {
+      context.server_->destroy_session(context.index_);
+      return false;
+   }
+
+   bool server::receive_input(message_context &, message_input &) {
+      // note: per frame input is a display hint between peers, the
+      //       authoritative simulation only runs on the input buffer
+      return true;
+   }
+
+   bool server::receive_input_buffer(message_context &context, message_input_buffer &message) {
+      context.server_->receive_input_buffer(context.index_, message);
+      return true;
+   }
+
+   bool server::receive_ping(message_context &context, message_ping &message) {
+      uu::receive_ping(context.server_->sessions_[context.index_].clock_, message, context.now_);
+      return true;
+   }
+
+   bool server::receive_pong(message_context &context, message_pong &message) {
+      uu::receive_pong(context.server_->sessions_[context.index_].clock_, message, context.now_);
+      return true;
+   }
+
+   void server::receive_input_buffer(uint32 index, message_input_buffer &message) {
+      session &s = sessions_[index];
+      if (s.match_ == invalid_index) {
+         return;
+      }
+
+      match_slot &slot = matches_[s.match_];
+      session &opponent = sessions_[slot.sessions_[s.side_ == MATCH_SIDE_LEFT ? MATCH_SIDE_RIGHT : MATCH_SIDE_LEFT]];
+
+      const std::vector<input> &entries = message.input_buffer_;
+      for (uint32 i = 0; i < (uint32)entries.size(); i++) {
+         // note: skip entries this session has already applied
+         const uint32 tick = message.base_tick_ + i;
+         if ((int32)(tick - s.remote_input_tick_) < 0) {
+            continue;
+         }
+
+         // note: the rewind an input asks for is the one both clients
+         //       simulate with, the wire format caps it at the history kept
+         slot.pending_[s.side_].push_back(entries[i]);
+         opponent.relay_buffer_.push_back(entries[i]);
+         s.remote_input_tick_ = tick + 1;
+      }
+   }
+
+   void server::start_match(uint32 left, uint32 right) {
+      if (free_matches_.empty()) {
+         return;
+      }
+
+      const uint32 index = free_matches_.back();
+      free_matches_.pop_back();
+      match_count_++;
+
+      match_slot &slot = matches_[index];
+      slot.active_ = true;
+      slot.sessions_[MATCH_SIDE_LEFT] = left;
+      slot.sessions_[MATCH_SIDE_RIGHT] = right;
+      slot.frame_ = 0;
+      slot.pending_[MATCH_SIDE_LEFT].clear();
+      slot.pending_[MATCH_SIDE_RIGHT].clear();
+      slot.match_.reset(sprite_sheet_, texture_);
+      slot.history_.reset();
+
+      // note: the clients treat the server as their opponent, they play as
+      //       soon as they have seen both a request and a response
+      for (int side = 0; side < MATCH_SIDE_COUNT; side++) {
+         session &s = sessions_[slot.sessions_[side]];
+         s.match_ = index;
+         s.side_ = (match_side)side;
+
+         message_connection_request request;
+         message_connection_response response;
+         response.random_ = connection_magic;
+         s.connection_.send_reliable(request);
+         s.connection_.send_reliable(response);
+      }
+   }
+
+   void server::end_match(uint32 index) {
+      match_slot &slot = matches_[index];
+      if (!slot.active_) {
+         return;
+      }
+
+      slot.active_ = false;
+      free_matches_.push_back(index);
+      match_count_--;
+
+      // note: spectators stop hearing from the match and time out upstream
+      delete slot.feed_;
+      slot.feed_ = nullptr;
+
+      // note: the remaining player goes back to the lobby with a fresh connection,
+      //       write the disconnect now since its session does not survive. it is
+      //       sent after the batch in progress, which may hold other sessions
+      const time now = time::now();
+      for (int side = 0; side < MATCH_SIDE_COUNT; side++) {
+         session &s = sessions_[slot.sessions_[side]];
+         s.match_ = invalid_index;
+         if (!s.is_active()) {
+            continue;
+         }
+
+         message_disconnect message;
+         s.connection_.send_reliable(message);
+
+         if (disconnect_count_ == batch_size) {
+            flush_batch(disconnect_addresses_, disconnect_streams_, disconnect_count_);
+         }
+
+         byte_stream &stream = disconnect_streams_[disconnect_count_];
+         if (s.connection_.write_packet(now, stream)) {
+            disconnect_addresses_[disconnect_count_++] = s.address_;
+         }
+      }
+
+      for (int side = 0; side < MATCH_SIDE_COUNT; side++) {
+         destroy_session(slot.sessions_[side]);
+      }
+   }
+
+   void server::tick(const time &now) {
+      for (uint32 index = 0; index < max_sessions_ / 2 + 1; index++) {
+         match_slot &slot = matches_[index];
+         if (!slot.active_) {
+            continue;
+         }
+
+         // note: no prediction here, the server only runs confirmed frames
+         std::vector<input> &left = slot.pending_[MATCH_SIDE_LEFT];
+         std::vector<input> &right = slot.pending_[MATCH_SIDE_RIGHT];
+         const uint32 count = (uint32)(left.size() < right.size() ? left.size() : right.size());
+         for (uint32 frame = 0; frame < count; frame++) {
+            slot.history_.step(slot.match_, slot.frame_ + frame, left[frame], right[frame]);
+         }
+         left.erase(left.begin(), left.begin() + count);
+         right.erase(right.begin(), right.begin() + count);
+         slot.frame_ += count;
+
+         if (slot.feed_) {
+            slot.feed_->update(slot.match_, socket_, now);
+         }
+      }
+
+      send(now);
+   }
+
+   void server::send(const time &now) {
+      uint32 count = 0;
+      for (uint32 index = 0; index < max_sessions_; index++) {
+         session &s = sessions_[index];
+         if (!s.is_active()) {
+            continue;
+         }
+
+         if (now.tick_ - s.last_received_ > session_timeout_ms) {
+            destroy_session(index);
+            continue;
+         }
+
+         // note: acked packets retire the relayed inputs they carried
+         uint16 sequence = 0;
+         while (s.connection_.poll_ack(sequence)) {
+            const uint32 end = s.sent_relay_tick_[sequence % connection::packet_window];
+            if ((int32)(end - s.relay_tick_) <= 0) {
+               continue;
+            }
+
+            const uint32 acked = end - s.relay_tick_;
+            if (acked >= s.relay_buffer_.size()) {
+               s.relay_buffer_.clear();
+            }
+            else {
+               s.relay_buffer_.erase(s.relay_buffer_.begin(), s.relay_buffer_.begin() + acked);
+            }
+            s.relay_tick_ = end;
+         }
+
+         // note: nothing is queued for a peer between its sends, the relay
+         //       buffer and the clock state are picked up by the next one
+         s.rate_.update(now, s.connection_, s.clock_);
+         if (!s.rate_.should_send(now)) {
+            continue;
+         }
+
+         uint32 end = s.relay_tick_;
+         if (!s.relay_buffer_.empty()) {
+            message_input_buffer message(s.relay_tick_, s.relay_buffer_);
+            if (s.connection_.send_unreliable(message)) {
+               end = message.base_tick_ + (uint32)message.input_buffer_.size();
+            }
+         }
+         s.sent_relay_tick_[s.connection_.next_sequence() % connection::packet_window] = end;
+         send_clock_messages(s.connection_, s.clock_, now);
+
+         byte_stream &stream = send_streams_[count];
+         if (!s.connection_.write_packet(now, stream)) {
+            continue;
+         }
+         s.rate_.on_sent(now, stream.length());
+
+         send_addresses_[count++] = s.address_;
+         if (count == batch_size) {
+            flush_batch(send_addresses_, send_streams_, count);
+         }
+      }
+
+      flush_batch(send_addresses_, send_streams_, count);
+      flush_batch(disconnect_addresses_, disconnect_streams_, disconnect_count_);
+   }
+
+   bool server::flush_batch(ip_address *addresses, byte_stream *streams, uint32 &count) {
+      uint32 offset = 0;
+      while (offset < count) {
+         uint32 sent = 0;
+         if (!engine_.send_batch(count - offset, addresses + offset, streams + offset, sent) || sent == 0) {
+            break;
+         }
+         offset += sent;
+      }
+
+      const bool result = offset == count;
+      count = 0;
+
+      return result;
+   }
+} // !uu
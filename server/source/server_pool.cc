@@ -0,0 +1,175 @@
+// server_pool.cc
+
+#include "server_pool.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace uu {
+   server_pool::server_pool()
+      : running_(false)
+      , port_(0)
+   {
+   }
+
+   server_pool::~server_pool() {
+      close();
+   }
+
+   bool server_pool::open(uint16 port, uint32 max_sessions, uint32 worker_count) {
+      if (!workers_.empty() || worker_count == 0 || worker_count > max_workers) {
+         return false;
+      }
+
+      // note: a lone worker needs no reuse port group, keeps windows working
+      const uint32 flags = worker_count > 1 ? udp_socket::OPEN_REUSE_PORT : udp_socket::OPEN_DEFAULT;
+      const uint32 sessions_per_worker = (max_sessions + worker_count - 1) / worker_count;
+
+      port_ = port;
+      for (uint32 index = 0; index < worker_count; index++) {
+         server *worker = new server;
+         if (!worker->open(port_, sessions_per_worker, flags)) {
+            delete worker;
+            close();
+            return false;
+         }
+         workers_.push_back(worker);
+
+         if (port_ == 0) {
+            ip_address local;
+            if (!worker->socket_.address_of(local)) {
+               close();
+               return false;
+            }
+            port_ = local.port_;
+         }
+      }
+
+      // note: the program is shared by the whole group, attaching it through
+      //       any member is enough. without it the kernel falls back to its
+      //       own 4-tuple hash, still stable per peer while the group is fixed
+      if (worker_count > 1) {
+         workers_[0]->socket_.attach_reuse_port_program(worker_count);
+      }
+
+      return true;
+   }
+
+   void server_pool::close() {
+      stop();
+
+      for (auto worker : workers_) {
+         delete worker;
+      }
+      workers_.clear();
+      port_ = 0;
+   }
+
+   bool server_pool::open_telemetry(const char *path, int64 interval_ms) {
+      if (!threads_.empty()) {
+         return false;
+      }
+
+      for (uint32 index = 0; index < (uint32)workers_.size(); index++) {
+         char name[512];
+         if (workers_.size() > 1) {
+            snprintf(name, sizeof(name), "%s.%u", path, index);
+         }
+         else {
+            snprintf(name, sizeof(name), "%s", path);
+         }
+
+         if (!workers_[index]->open_telemetry(name, interval_ms)) {
+            return false;
+         }
+      }
+
+      return true;
+   }
+
+   bool server_pool::start() {
+      if (workers_.empty() || !threads_.empty()) {
+         return false;
+      }
+
+      running_ = true;
+      for (uint32 index = 0; index < (uint32)workers_.size(); index++) {
+         threads_.emplace_back(&server_pool::run, this, index);
+      }
+
+      return true;
+   }
+
+   void server_pool::stop() {
+      running_ = false;
+      for (auto &thread : threads_) {
+         thread.join();
+      }
+      threads_.clear();
+   }
+
+   uint16 server_pool::port() const {
+      return port_;
+   }
+
+   uint32 server_pool::worker_count() const {
+      return (uint32)workers_.size();
+   }
+
+   uint32 server_pool::session_count() const {
+      uint32 result = 0;
+      for (auto worker : workers_) {
+         result += worker->session_count();
+      }
+      return result;
+   }
+
+   uint32 server_pool::match_count() const {
+      uint32 result = 0;
+      for (auto worker : workers_) {
+         result += worker->match_count();
+      }
+      return result;
+   }
+
+   uint64 server_pool::packets_received() const {
+      uint64 result = 0;
+      for (auto worker : workers_) {
+         result += worker->packets_received();
+      }
+      return result;
+   }
+
+   uint64 server_pool::handshakes_rejected() const {
+      uint64 result = 0;
+      for (auto worker : workers_) {
+         result += worker->handshakes_rejected();
+      }
+      return result;
+   }
+
+   void server_pool::read_socket_stats(socket_stats::snapshot &result) const {
+      // note: the counters are read while the workers keep writing them
+      memset(&result, 0, sizeof(result));
+      for (auto worker : workers_) {
+         socket_stats::snapshot stats;
+         worker->socket_.stats_.read(stats);
+         result.packets_in_ += stats.packets_in_;
+         result.bytes_in_ += stats.bytes_in_;
+         result.packets_out_ += stats.packets_out_;
+         result.bytes_out_ += stats.bytes_out_;
+         result.would_block_ += stats.would_block_;
+         for (uint32 index = 0; index <= NETERR_UNKNOWN; index++) {
+            result.errors_[index] += stats.errors_[index];
+         }
+      }
+   }
+
+   void server_pool::run(uint32 worker) {
+      server *host = workers_[worker];
+      while (running_) {
+         host->update(gamma::time::now());
+         host->wait(gamma::time::now());
+      }
+   }
+} // !uu
@@ -0,0 +1,130 @@
+// session_table.cc
+
+#include "server.h"
+
+namespace uu {
+   namespace {
+      constexpr uint64 empty_key = ~0ull;
+
+      uint64 key_of(const ip_address &address) {
+         return ((uint64)address.host_ << 16) | address.port_;
+      }
+
+      uint32 hash_of(uint64 key) {
+         // note: fibonacci hashing, the high bits are the well mixed ones
+         return (uint32)((key * 0x9e3779b97f4a7c15ull) >> 32);
+      }
+   } // !anon
+
+   session_table::session_table()
+      : mask_(0)
+      , count_(0)
+      , slots_(nullptr)
+   {
+   }
+
+   session_table::~session_table() {
+      destroy();
+   }
+
+   bool session_table::create(uint32 max_entries) {
+      destroy();
+
+      // note: keep the load factor at or below one half
+      uint32 capacity = 16;
+      while (capacity < max_entries * 2) {
+         capacity <<= 1;
+      }
+
+      slots_ = new slot[capacity];
+      for (uint32 index = 0; index < capacity; index++) {
+         slots_[index].key_ = empty_key;
+         slots_[index].value_ = invalid_index;
+      }
+
+      mask_ = capacity - 1;
+      count_ = 0;
+
+      return true;
+   }
+
+   void session_table::destroy() {
+      delete[] slots_;
+      slots_ = nullptr;
+      mask_ = 0;
+      count_ = 0;
+   }
+
+   uint32 session_table::find(const ip_address &address) const {
+      if (!slots_) {
+         return invalid_index;
+      }
+
+      const uint64 key = key_of(address);
+      for (uint32 index = hash_of(key) & mask_; ; index = (index + 1) & mask_) {
+         const slot &s = slots_[index];
+         if (s.key_ == key) {
+            return s.value_;
+         }
+         if (s.key_ == empty_key) {
+            return invalid_index;
+         }
+      }
+   }
+
+   bool session_table::insert(const ip_address &address, uint32 value) {
+      if (!slots_ || (count_ + 1) * 2 > mask_ + 1) {
+         return false;
+      }
+
+      const uint64 key = key_of(address);
+      for (uint32 index = hash_of(key) & mask_; ; index = (index + 1) & mask_) {
+         slot &s = slots_[index];
+         if (s.key_ == key) {
+            return false;
+         }
+         if (s.key_ == empty_key) {
+            s.key_ = key;
+            s.value_ = value;
+            count_++;
+            return true;
+         }
+      }
+   }
+
+   bool session_table::erase(const ip_address &address) {
+      if (!slots_) {
+         return false;
+      }
+
+      const uint64 key = key_of(address);
+      uint32 index = hash_of(key) & mask_;
+      while (slots_[index].key_ != key) {
+         if (slots_[index].key_ == empty_key) {
+            return false;
+         }
+         index = (index + 1) & mask_;
+      }
+
+      // note: backward shift, pull up every entry whose probe sequence
+      //       passes through the hole until an empty slot is reached
+      uint32 hole = index;
+      for (uint32 next = (hole + 1) & mask_; slots_[next].key_ != empty_key; next = (next + 1) & mask_) {
+         const uint32 home = hash_of(slots_[next].key_) & mask_;
+         if (((next - home) & mask_) >= ((next - hole) & mask_)) {
+            slots_[hole] = slots_[next];
+            hole = next;
+         }
+      }
+
+      slots_[hole].key_ = empty_key;
+      slots_[hole].value_ = invalid_index;
+      count_--;
+
+      return true;
+   }
+
+   uint32 session_table::size() const {
+      return count_;
+   }
+} // !uu
@@ -0,0 +1,143 @@
+// spectator_feed.cc
+
+#include "server.h"
+
+namespace uu {
+   spectator_list::spectator_list()
+      : max_spectators_(0)
+      , next_expire_(0)
+   {
+   }
+
+   bool spectator_list::create(uint32 max_spectators) {
+      destroy();
+      if (!table_.create(max_spectators)) {
+         return false;
+      }
+
+      max_spectators_ = max_spectators;
+      addresses_.reserve(max_spectators);
+      last_seen_.reserve(max_spectators);
+
+      return true;
+   }
+
+   void spectator_list::destroy() {
+      table_.destroy();
+      addresses_.clear();
+      last_seen_.clear();
+      max_spectators_ = 0;
+      next_expire_ = 0;
+   }
+
+   bool spectator_list::subscribe(const ip_address &address, const time &now) {
+      const uint32 index = table_.find(address);
+      if (index != invalid_index) {
+         last_seen_[index] = now.tick_;
+         return true;
+      }
+
+      if (size() == max_spectators_ || !table_.insert(address, size())) {
+         return false;
+      }
+
+      addresses_.push_back(address);
+      last_seen_.push_back(now.tick_);
+
+      return true;
+   }
+
+   void spectator_list::expire(const time &now) {
+      if (now.tick_ < next_expire_) {
+         return;
+      }
+      next_expire_ = now.tick_ + expire_interval_ms;
+
+      // note: swap with the last so the addresses stay dense
+      uint32 index = 0;
+      while (index < size()) {
+         if (now.tick_ - last_seen_[index] <= timeout_ms) {
+            index++;
+            continue;
+         }
+
+         table_.erase(addresses_[index]);
+         const uint32 last = size() - 1;
+         if (index != last) {
+            table_.erase(addresses_[last]);
+            addresses_[index] = addresses_[last];
+            last_seen_[index] = last_seen_[last];
+            table_.insert(addresses_[index], index);
+         }
+         addresses_.pop_back();
+         last_seen_.pop_back();
+      }
+   }
+
+   uint32 spectator_list::size() const {
+      return (uint32)addresses_.size();
+   }
+
+   bool spectator_list::send(udp_socket &socket, const byte_stream &stream) {
+      // note: best effort, a peer skipped on a full socket buffer misses
+      //       this tick like it would on a lost datagram
+      uint32 offset = 0;
+      while (offset < size()) {
+         uint32 sent = 0;
+         if (!socket.send_fanout(size() - offset, addresses_.data() + offset, stream, sent) && sent == 0) {
+            break;
+         }
+         offset += sent;
+      }
+
+      return offset == size();
+   }
+
+   spectator_feed::spectator_feed()
+      : tick_(0)
+      , keyframe_tick_(0)
+   {
+   }
+
+   bool spectator_feed::create(uint32 max_spectators) {
+      tick_ = 0;
+      keyframe_tick_ = 0;
+      history_.reset();
+      keyframes_.reset();
+
+      return spectators_.create(max_spectators);
+   }
+
+   void spectator_feed::update(const match &m, udp_socket &socket, const time &now) {
+      spectators_.expire(now);
+
+      // note: tick zero never goes out, it stands for the empty baseline
+      snapshot current;
+      current.capture(m, ++tick_);
+      history_.push(current);
+
+      if (spectators_.size() == 0 || tick_ <= delay_ticks) {
+         return;
+      }
+
+      const snapshot *delayed = history_.find(tick_ - delay_ticks);
+      if (!delayed) {
+         return;
+      }
+
+      if (delayed->tick_ - keyframe_tick_ >= keyframe_ticks || !keyframes_.find(keyframe_tick_)) {
+         keyframe_tick_ = delayed->tick_;
+         keyframes_.push(*delayed);
+      }
+
+      // note: a keyframe is its own baseline, which encodes as age zero
+      message_snapshot message(keyframes_, *delayed, keyframe_tick_);
+      byte_stream stream(sizeof(buffer_), buffer_);
+      bit_writer writer(stream);
+      if (!message.serialize(writer) || !writer.flush()) {
+         return;
+      }
+
+      spectators_.send(socket, stream);
+   }
+} // !uu
@@ -0,0 +1,177 @@
+// spectator_relay.cc
+
+#include "spectator_relay.h"
+
+namespace uu {
+   spectator_link::spectator_link()
+      : match_(invalid_index)
+      , subscribed_(-1)
+      , requested_(-1)
+      , backoff_ms_(resend_ms)
+   {
+   }
+
+   void spectator_link::reset(const ip_address &upstream, uint32 match) {
+      upstream_ = upstream;
+      match_ = match;
+      subscribed_ = -1;
+      requested_ = -1;
+      backoff_ms_ = resend_ms;
+   }
+
+   void spectator_link::update(udp_socket &socket, const time &now) {
+      if (subscribed_ >= 0 && now.tick_ - subscribed_ < resubscribe_ms) {
+         return;
+      }
+      if (requested_ >= 0) {
+         if (now.tick_ - requested_ < backoff_ms_) {
+            return;
+         }
+         backoff_ms_ = backoff_ms_ * 2 < max_resend_ms ? backoff_ms_ * 2 : max_resend_ms;
+      }
+
+      uint8 buffer[handshake_size];
+      byte_stream stream(sizeof(buffer), buffer);
+      message_handshake request(MESSAGE_HANDSHAKE_REQUEST, 0, 0);
+      if (write_handshake(stream, request) && socket.send_to(upstream_, stream)) {
+         requested_ = now.tick_;
+      }
+   }
+
+   bool spectator_link::receive(udp_socket &socket, byte_stream &stream, const time &now) {
+      message_handshake challenge;
+      if (!read_handshake(stream, challenge)) {
+         return false;
+      }
+      if (challenge.type_ != MESSAGE_HANDSHAKE_CHALLENGE) {
+         return true;
+      }
+
+      uint8 buffer[message_spectate::max_bits / 8];
+      byte_stream reply(sizeof(buffer), buffer);
+      message_spectate spectate(challenge.issued_, challenge.cookie_, match_);
+      if (write_spectate(reply, spectate) && socket.send_to(upstream_, reply)) {
+         subscribed_ = now.tick_;
+         requested_ = -1;
+         backoff_ms_ = resend_ms;
+      }
+
+      return true;
+   }
+
+   spectator_relay::spectator_relay()
+      : forwarded_(0)
+      , handshakes_rejected_(0)
+   {
+   }
+
+   spectator_relay::~spectator_relay() {
+      close();
+   }
+
+   bool spectator_relay::open(uint16 port, const ip_address &upstream, uint32 match, uint32 max_spectators) {
+      if (socket_.is_valid()) {
+         return false;
+      }
+
+      ip_address local;
+      local.set_port(port);
+      if (!socket_.open(local)) {
+         return false;
+      }
+
+      ip_address any;
+      if (!upstream_socket_.open(any) || !engine_.open(socket_) || !spectators_.create(max_spectators)) {
+         close();
+         return false;
+      }
+
+      upstream_.reset(upstream, match);
+      cookies_.reset();
+      forwarded_ = 0;
+      handshakes_rejected_ = 0;
+
+      return true;
+   }
+
+   void spectator_relay::close() {
+      engine_.close();
+      socket_.close();
+      upstream_socket_.close();
+      spectators_.destroy();
+   }
+
+   void spectator_relay::update(const time &now) {
+      // note: the stream first, it is what everyone below is waiting for
+      byte_stream stream(sizeof(receive_buffer_[0]), receive_buffer_[0]);
+      ip_address from;
+      while (upstream_socket_.recv_from(from, stream)) {
+         if (from == upstream_.upstream_) {
+            receive_upstream(stream, now);
+         }
+         stream.reset();
+      }
+      upstream_.update(upstream_socket_, now);
+
+      uint32 received = 0;
+      do {
+         for (uint32 packet = 0; packet < batch_size; packet++) {
+            receive_streams_[packet] = byte_stream(sizeof(receive_buffer_[packet]), receive_buffer_[packet]);
+         }
+
+         received = 0;
+         if (!engine_.recv_batch(batch_size, receive_addresses_, receive_streams_, received)) {
+            break;
+         }
+
+         for (uint32 packet = 0; packet < received; packet++) {
+            receive(receive_addresses_[packet], receive_streams_[packet], now);
+         }
+      } while (received == batch_size);
+
+      spectators_.expire(now);
+   }
+
+   void spectator_relay::wait(int64 timeout_ms) {
+      engine_.wait(timeout_ms);
+   }
+
+   void spectator_relay::receive_upstream(byte_stream &stream, const time &now) {
+      if (upstream_.receive(upstream_socket_, stream, now)) {
+         return;
+      }
+
+      // note: forwarded as is, the relay never decodes a snapshot
+      bit_reader reader(stream);
+      uint8 type = MESSAGE_UNKNOWN;
+      if (reader.peek(type) && type == MESSAGE_SNAPSHOT) {
+         spectators_.send(socket_, stream);
+         forwarded_++;
+      }
+   }
+
+   void spectator_relay::receive(const ip_address &address, byte_stream &stream, const time &now) {
+      message_spectate spectate;
+      if (read_spectate(stream, spectate)) {
+         if (!cookies_.verify(address, spectate.issued_, spectate.cookie_, now)) {
+            handshakes_rejected_++;
+            return;
+         }
+
+         spectators_.subscribe(address, now);
+         return;
+      }
+
+      message_handshake request;
+      if (!read_handshake(stream, request) || request.type_ != MESSAGE_HANDSHAKE_REQUEST) {
+         return;
+      }
+
+      uint8 buffer[handshake_size];
+      byte_stream reply(sizeof(buffer), buffer);
+      message_handshake challenge = cookies_.challenge(address, now);
+      if (write_handshake(reply, challenge)) {
+         socket_.send_to(address, reply);
+      }
+   }
+} // !uu
@@ -48,7 +48,16 @@ namespace uu {
       collider collider_;
    };
 
+   // note: invaders, bullets and explosions keep one array per field, the
+   //       update loops walk only the fields they change and no longer
+   //       keep a sprite and a collider in step with every move. objects
+   //       of one kind share their size, so extent_ is stored once, and
+   //       the sprites are templates only positioned at render time.
+   //       colliders are built on demand, centered on position + extent
    struct invaders {
+      static constexpr uint32 capacity = 35;
+      static constexpr uint32 row_count = 7;
+
       invaders(const vector2 &offset, const vector2 &direction);
 
       void update(const time &dt);
@@ -58,39 +67,64 @@ namespace uu {
       void reset(sprite_sheet &sheet, texture &image, bool left);
       void calculate_area();
       void remove_random();
+      collider collider_of(uint32 index) const;
 
-      rectangle sources_[5];
+      // note: the whole formation moves along direction_
+      sprite sprites_[capacity / row_count];
       vector2 offset_;
       vector2 direction_;
+      vector2 extent_;
       rectangle area_;
       int entity_count_;
-      entity entity_[35];
+      bool alive_[capacity];
+      vector2 position_[capacity];
    };
 
+   // note: bullets and explosions are dense, the count_ live ones fill the
+   //       front of the arrays and the free slots are the tail. spawn takes
+   //       the first free slot, despawn moves the last live one into the
+   //       gap, so both are O(1) and loops only visit live objects. a spawn
+   //       into a full pool is dropped and counted in overflows_. live
+   //       objects change slots as others go, never keep an index around
    struct bullets {
+      static constexpr uint32 capacity = 32;
+      static constexpr float speed = 300.0f;
+
       bullets();
 
       void update(const time &dt);
       void render(render_system &rs);
 
       void reset(sprite_sheet &sheet, texture &image);
-      void spawn(const vector2 &position, const vector2 &direction);
-      
-      vector2 direction_[32];
-      entity entity_[32];
+      bool spawn(const vector2 &position, const vector2 &direction);
+      void despawn(uint32 index);
+      collider collider_of(uint32 index) const;
+
+      sprite sprite_;
+      vector2 extent_;
+      uint32 count_;
+      uint32 overflows_;
+      vector2 position_[capacity];
+      vector2 velocity_[capacity];
    };
 
    struct explosions {
+      static constexpr uint32 capacity = 32;
+
       explosions();
 
       void update(const time &dt);
       void render(render_system &rs);
 
       void reset(sprite_sheet &sheet, texture &image);
-      void spawn(const vector2 &position);
+      bool spawn(const vector2 &position);
+      void despawn(uint32 index);
 
-      time lifetime_[32];
-      entity entity_[32];
+      sprite sprite_;
+      uint32 count_;
+      uint32 overflows_;
+      vector2 position_[capacity];
+      time lifetime_[capacity];
    };
 
    struct spaceship {
@@ -115,7 +149,7 @@ namespace uu {
 
       void reset(sprite_sheet &sheet, texture &image, const int sprite_begin);
 
-      const vector2 size_;
+      vector2 size_;
       rectangle source_[5];
       int sprite_begin_;
       int health_[3];
@@ -11,5 +11,9 @@ struct input
 
 	uint8_t input_;
 	uint64_t dt_;
+
+	// note: ticks the sender played ahead of the remote inputs it had, its
+	//       bullets are checked against the world that many ticks back
+	uint8_t rewind_;
 };
 
@@ -0,0 +1,47 @@
+// interpolation_buffer.h
+
+#ifndef INTERPOLATION_BUFFER_H_INCLUDED
+#define INTERPOLATION_BUFFER_H_INCLUDED
+
+#include "match.h"
+
+namespace uu {
+   // note: what the client shows of the remote side. the remote ship and
+   //       invader formation are recorded with the local time of every
+   //       frame and drawn delay_ms_ in the past, so a burst of remote
+   //       inputs or a rollback correction turns into a slide instead of a
+   //       jump. the delay follows the measured arrival jitter, past the
+   //       newest sample positions are extrapolated for a short while only
+   struct interpolation_buffer {
+      static constexpr uint32 capacity = 32;
+      static constexpr float min_delay_ms = (float)match::tick_ms;
+      static constexpr float max_delay_ms = 200.0f;
+      static constexpr int64 max_extrapolation_ms = 50;
+
+      struct sample {
+         int64 time_;
+         vector2 ship_;
+         vector2 formation_;
+      };
+
+      interpolation_buffer();
+
+      void reset();
+      void push(const time &now, const match &m);
+      void set_jitter(float jitter_ms);
+
+      // note: moves the remote side of m to where it was delay_ms_ ago,
+      //       m is meant to be a copy made for rendering
+      void apply(const time &now, match &m);
+
+      bool sample_at(int64 at, sample &result);
+
+      sample samples_[capacity];
+      uint32 count_;
+      uint32 newest_;
+      float delay_ms_;
+      uint32 underruns_;
+   };
+} // !uu
+
+#endif // !INTERPOLATION_BUFFER_H_INCLUDED
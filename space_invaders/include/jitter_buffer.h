@@ -0,0 +1,55 @@
+// jitter_buffer.h
+
+#ifndef JITTER_BUFFER_H_INCLUDED
+#define JITTER_BUFFER_H_INCLUDED
+
+#include "match.h"
+
+namespace uu {
+   // note: playout buffer for remote inputs keyed by remote tick. inputs
+   //       are held until the buffer reaches its target depth and then
+   //       released one per local tick, so a bunched packet turns into
+   //       steady motion instead of a burst of corrections. the target
+   //       covers the ticks a packet usually carries plus twice the
+   //       measured arrival jitter
+   struct jitter_buffer {
+      static constexpr uint32 capacity = 64;
+      static constexpr uint32 max_depth = 16;
+
+      jitter_buffer();
+
+      void reset();
+
+      // note: push every entry of a packet, then call arrived once
+      bool push(uint32 tick, const input &value);
+      void arrived(const time &now);
+
+      // note: tick once per local simulation tick, then pop until false.
+      //       flush releases everything buffered, for when the simulation
+      //       is stalled on the remote anyway
+      void tick();
+      void flush();
+      bool pop(uint32 &tick, input &value);
+
+      uint32 depth() const;
+
+      input inputs_[capacity];
+      bool valid_[capacity];
+      uint32 next_tick_;
+      uint32 newest_tick_;
+      uint32 credit_;
+      bool playing_;
+
+      bool has_arrival_;
+      uint32 arrival_tick_;
+      int64 transit_;
+      float jitter_ms_;
+      float burst_;
+      uint32 target_depth_;
+
+      uint32 underruns_;
+      uint32 overflows_;
+   };
+} // !uu
+
+#endif // !JITTER_BUFFER_H_INCLUDED
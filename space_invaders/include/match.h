@@ -0,0 +1,53 @@
+// match.h
+
+#ifndef MATCH_H_INCLUDED
+#define MATCH_H_INCLUDED
+
+#include "entity.h"
+#include "input.h"
+
+namespace uu {
+   enum match_side {
+      MATCH_SIDE_LEFT,
+      MATCH_SIDE_RIGHT,
+      MATCH_SIDE_COUNT,
+   };
+
+   struct hit_targets;
+
+   // note: the simulation state of one game, shared by the client and the
+   //       headless server. step advances everything by one fixed tick from
+   //       the inputs of both sides, the same inputs always produce the same
+   //       state. plain data, a copy is a complete snapshot
+   struct match {
+      static constexpr int64 tick_ms = 16;
+
+      match();
+
+      void reset(sprite_sheet &sheet, texture &image);
+      void step(const input &left, const input &right);
+      void apply_input(match_side side, const input &input);
+      void update(const time &dt);
+
+      // note: the bullets of a side are checked against rewound[side]
+      //       instead of the current ships and invaders where it is set
+      void step(const input &left, const input &right, const hit_targets *const (&rewound)[MATCH_SIDE_COUNT]);
+      void update(const time &dt, const hit_targets *const (&rewound)[MATCH_SIDE_COUNT]);
+      void render(render_system &rs);
+
+      sprite_sheet *sheet_;
+      bullets bullets_;
+      explosions explosions_;
+      invaders invaders_[MATCH_SIDE_COUNT];
+      spaceship ships_[MATCH_SIDE_COUNT];
+      blocks blocks_[MATCH_SIDE_COUNT];
+   };
+
+   // note: the colliders of the ships and invaders as a shooter saw them
+   struct hit_targets {
+      collider ships_[MATCH_SIDE_COUNT];
+      collider invaders_[MATCH_SIDE_COUNT][invaders::capacity];
+   };
+} // !uu
+
+#endif // !MATCH_H_INCLUDED
@@ -16,39 +16,51 @@ namespace uu {
       MESSAGE_CONNECTION_RESPONSE,
       MESSAGE_DISCONNECT,
       MESSAGE_INPUT,
+      MESSAGE_INPUT_BUFFER,
+      MESSAGE_PING,
+      MESSAGE_PONG,
+      MESSAGE_SNAPSHOT,
+      MESSAGE_HANDSHAKE_REQUEST,
+      MESSAGE_HANDSHAKE_CHALLENGE,
+      MESSAGE_HANDSHAKE_RESPONSE,
+      MESSAGE_SPECTATE,
       MESSAGE_COUNT,
    };
 
    static_assert(MESSAGE_COUNT < 255, "Message types cannot exceed 255");
 
+   // note: wire budgets, shared by the byte and the bit packed streams
+   constexpr uint32 message_header_bits = 8;
+   constexpr uint32 input_bits = 3;
+   constexpr uint32 input_rewind_bits = 4;
+   constexpr uint64 max_input_dt_ms = 255;
+   constexpr uint32 input_dt_bits = bits_required(max_input_dt_ms);
+
+   // note: messages with a fixed layout describe it once as a schema, it
+   //       provides both directions of serialize and the max_bits bound
    struct message_header {
       message_header();
       explicit message_header(message_type_id type);
 
       template <typename S>
       bool serialize(S &stream) {
-         if (!stream.serialize(type_)) {
-            return false;
-         }
-         return true;
+         return schema::serialize(stream, *this);
       }
 
       uint8 type_;
+
+      using schema = message_schema<schema_value<message_header, uint8, &message_header::type_>>;
    };
 
+   static_assert(message_header::schema::max_bits == message_header_bits, "Header size changed");
+
    struct message_connection_request : message_header {
       message_connection_request();
       explicit message_connection_request(uint32 random);
 
       template <typename S>
       bool serialize(S &stream) {
-         if (!message_header::serialize(stream)) {
-            return false;
-         }
-         if (!stream.serialize(random_)) {
-            return false;
-         }
-         return true;
+         return schema::serialize(stream, *this);
       }
 
 	  bool is_valid() const
@@ -57,6 +69,10 @@ namespace uu {
 	  }
 
       uint32 random_;
+
+      using schema = message_schema<message_header::schema,
+                                    schema_value<message_connection_request, uint32, &message_connection_request::random_>>;
+      static constexpr uint32 max_bits = schema::max_bits;
    };
 
    struct message_connection_response : message_header {
@@ -64,16 +80,14 @@ namespace uu {
 
       template <typename S>
       bool serialize(S &stream) {
-         if (!message_header::serialize<S>(stream)) {
-            return false;
-         }
-         if (!stream.serialize(random_)) {
-            return false;
-         }
-         return true;
+         return schema::serialize(stream, *this);
       }
 
       uint32 random_;
+
+      using schema = message_schema<message_header::schema,
+                                    schema_value<message_connection_response, uint32, &message_connection_response::random_>>;
+      static constexpr uint32 max_bits = schema::max_bits;
    };
 
    struct message_disconnect : message_header {
@@ -81,11 +95,11 @@ namespace uu {
 
       template <typename S>
       bool serialize(S &stream) {
-         if (!message_header::serialize<S>(stream)) {
-            return false;
-         }
-         return true;
+         return schema::serialize(stream, *this);
       }
+
+      using schema = message_header::schema;
+      static constexpr uint32 max_bits = schema::max_bits;
    };
 
    struct message_input : message_header {
@@ -94,13 +108,7 @@ namespace uu {
 
       template <typename S>
       bool serialize(S &stream) {
-         if (!message_header::serialize<S>(stream)) {
-            return false;
-         }
-         if (!stream.serialize(input_)) {
-            return false;
-         }
-         return true;
+         return schema::serialize(stream, *this);
       }
 
 	  bool is_valid() const
@@ -113,14 +121,33 @@ namespace uu {
       bool has_space() const;
 
       uint8 input_;
+
+      using schema = message_schema<message_header::schema,
+                                    schema_int<message_input, uint8, &message_input::input_, 0, (1 << input_bits) - 1>>;
+      static constexpr uint32 max_bits = schema::max_bits;
    };
 
-   constexpr size_t buffer_size = 12;
+   // note: wire format revision of message_input_buffer, bumped on layout changes
+   constexpr uint8 input_buffer_version = 3;
+   constexpr uint32 input_buffer_version_bits = 4;
+
+   // note: upper bound of entries per message, also guards the receiver
+   //       against allocating for a bogus count
+   constexpr uint32 max_input_buffer_count = 256;
+
+   // note: worst case is one run per entry; run length and frame delta
+   //       each take at most two varint bytes at these bounds
+   constexpr uint32 max_input_run_bits = 16 + input_bits + input_rewind_bits + 16;
+   static_assert(max_input_dt_ms < (1 << 14), "Frame delta must fit in two varint bytes");
+
    struct message_input_buffer : message_header
    {
 	   message_input_buffer();
-	   explicit message_input_buffer(const std::vector<input>& input_buffer);
+	   explicit message_input_buffer(uint32 base_tick, const std::vector<input>& input_buffer);
 
+	   // note: entries are written as runs of identical input and frame delta.
+	   //       the same code path reads and writes, on read the run length
+	   //       computed over the default entries is overwritten from the stream.
 	   template <typename S>
 	   bool serialize(S& serializer)
 	   {
@@ -128,21 +155,274 @@ namespace uu {
 		   {
 			   return false;
 		   }
-		   
-		   for (int i = 0; i < buffer_size; ++i)
+
+		   if (!serializer.serialize_int(version_, 0, (1 << input_buffer_version_bits) - 1))
+			   return false;
+		   if (version_ != input_buffer_version)
+			   return false;
+
+		   uint32 count = (uint32)input_buffer_.size();
+		   if (!(serializer.serialize_varint(count) && serializer.serialize_varint(base_tick_)))
+			   return false;
+		   if (count > max_input_buffer_count)
+			   return false;
+		   input_buffer_.resize(count);
+
+		   uint32 index = 0;
+		   while (index < count)
 		   {
-			   if(!(serializer.serialize(input_buffer_[i].input_) 
-				  && serializer.serialize(input_buffer_[i].dt_)))
-				  return false;
+			   uint32 run = run_length(index);
+			   if (!serializer.serialize_varint(run))
+				   return false;
+			   if (run == 0 || index + run > count)
+				   return false;
+
+			   input& entry = input_buffer_[index];
+			   uint32 dt = (uint32)entry.dt_;
+			   if (!(serializer.serialize_int(entry.input_, 0, (1 << input_bits) - 1)
+				  && serializer.serialize_int(entry.rewind_, 0, (1 << input_rewind_bits) - 1)
+				  && serializer.serialize_varint(dt)))
+				   return false;
+			   entry.dt_ = dt;
+
+			   for (uint32 i = 1; i < run; ++i)
+			   {
+				   input_buffer_[index + i] = entry;
+			   }
+			   index += run;
 		   }
 
 		   return true;
 	   }
 
-	   input input_buffer_[buffer_size];
-	   size_t size_;
+	   uint32 run_length(uint32 index) const;
+
+	   static constexpr uint32 max_bits = message_header_bits + input_buffer_version_bits + 
+		   2 * 40 + max_input_buffer_count * max_input_run_bits;
+
+	   uint8 version_;
+	   uint32 base_tick_;
+	   std::vector<input> input_buffer_;
+   };
+
+   // note: carries the senders time::now(), answered with a pong
+   struct message_ping : message_header {
+      message_ping();
+      explicit message_ping(uint64 time);
+
+      template <typename S>
+      bool serialize(S &stream) {
+         return schema::serialize(stream, *this);
+      }
+
+      uint64 time_;
+
+      using schema = message_schema<message_header::schema,
+                                    schema_value<message_ping, uint64, &message_ping::time_>>;
+      static constexpr uint32 max_bits = schema::max_bits;
+   };
+
+   // note: echoes the time of a ping next to the answering side's own
+   //       time and how long the ping waited there, see clock_sync
+   struct message_pong : message_header {
+      message_pong();
+      explicit message_pong(uint64 echo, uint64 time, uint16 hold);
+
+      template <typename S>
+      bool serialize(S &stream) {
+         return schema::serialize(stream, *this);
+      }
+
+      uint64 echo_;
+      uint64 time_;
+      uint16 hold_;
+
+      using schema = message_schema<message_header::schema,
+                                    schema_value<message_pong, uint64, &message_pong::echo_>,
+                                    schema_value<message_pong, uint64, &message_pong::time_>,
+                                    schema_value<message_pong, uint16, &message_pong::hold_>>;
+      static constexpr uint32 max_bits = schema::max_bits;
+   };
+
+   // note: identifies handshakes of this game and wire revision, 'SIV1'
+   constexpr uint32 protocol_id = 0x53495631;
+
+   // note: stateless handshake in front of the connection. a request is
+   //       answered with a challenge whose cookie is a keyed hash of the
+   //       clients address and the time it was issued, the server only
+   //       allocates a session for a response echoing a cookie that still
+   //       verifies. all three share one layout, so a request is never
+   //       smaller than the challenge it triggers
+   struct message_handshake : message_header {
+      message_handshake();
+      explicit message_handshake(message_type_id type, uint32 issued, uint64 cookie);
+
+      template <typename S>
+      bool serialize(S &stream) {
+         return schema::serialize(stream, *this);
+      }
+
+      bool is_valid() const;
+
+      uint32 protocol_;
+      uint32 issued_;
+      uint64 cookie_;
+
+      using schema = message_schema<message_header::schema,
+                                    schema_value<message_handshake, uint32, &message_handshake::protocol_>,
+                                    schema_value<message_handshake, uint32, &message_handshake::issued_>,
+                                    schema_value<message_handshake, uint64, &message_handshake::cookie_>>;
+      static constexpr uint32 max_bits = schema::max_bits;
+   };
+
+   // note: asks for the snapshot stream of a match instead of a session,
+   //       with a cookie from a challenge like a handshake response. an
+   //       invalid match index picks any running match. resent to stay
+   //       subscribed, see spectator_list
+   struct message_spectate : message_header {
+      message_spectate();
+      explicit message_spectate(uint32 issued, uint64 cookie, uint32 match);
+
+      template <typename S>
+      bool serialize(S &stream) {
+         return schema::serialize(stream, *this);
+      }
+
+      bool is_valid() const;
+
+      uint32 protocol_;
+      uint32 issued_;
+      uint64 cookie_;
+      uint32 match_;
+
+      using schema = message_schema<message_header::schema,
+                                    schema_value<message_spectate, uint32, &message_spectate::protocol_>,
+                                    schema_value<message_spectate, uint32, &message_spectate::issued_>,
+                                    schema_value<message_spectate, uint64, &message_spectate::cookie_>,
+                                    schema_value<message_spectate, uint32, &message_spectate::match_>>;
+      static constexpr uint32 max_bits = schema::max_bits;
    };
 
+   // note: handshakes travel as bare datagrams outside of any connection,
+   //       read only accepts a datagram of exactly the size and layout of M
+   template <typename M>
+   bool write_datagram(byte_stream &stream, M &message) {
+      static_assert(M::max_bits % 8 == 0, "A bare datagram must fill whole bytes");
+      stream.reset();
+      bit_writer writer(stream);
+      return message.serialize(writer) && writer.flush();
+   }
+
+   template <typename M>
+   bool read_datagram(byte_stream &stream, M &message) {
+      if (stream.length() != M::max_bits / 8) {
+         return false;
+      }
+
+      bit_reader reader(stream);
+      return message.serialize(reader) && message.is_valid();
+   }
+
+   constexpr uint64 handshake_size = message_handshake::max_bits / 8;
+
+   bool write_handshake(byte_stream &stream, message_handshake &message);
+   bool read_handshake(byte_stream &stream, message_handshake &message);
+   bool write_spectate(byte_stream &stream, message_spectate &message);
+   bool read_spectate(byte_stream &stream, message_spectate &message);
+
+   // note: queues a ping when one is due and the pong owed for the last
+   //       ping received, call right before the packet is written
+   void send_clock_messages(connection &c, clock_sync &clock, const time &now);
+
+   // note: feed a received ping or pong into clock
+   void receive_ping(clock_sync &clock, const message_ping &message, const time &now);
+   void receive_pong(clock_sync &clock, const message_pong &message, const time &now);
+
+   enum dispatch_result {
+      DISPATCH_CONTINUE,
+      DISPATCH_STOP,
+      DISPATCH_MALFORMED,
+   };
+
+   // note: walks every message of a stream, the type is read once from the
+   //       header and indexes a table of handlers. each handler parses its
+   //       own message, the walk ends at the first unknown or malformed
+   //       message or when a handler asks to stop. received_ and
+   //       malformed_ count per type, unhandled_ counts unknown types
+   template <typename Context>
+   struct message_dispatcher {
+      using handler = dispatch_result (*)(Context &context, bit_reader &reader);
+
+      message_dispatcher()
+         : unhandled_(0)
+      {
+         for (uint32 index = 0; index < MESSAGE_COUNT; index++) {
+            handlers_[index] = nullptr;
+            received_[index] = 0;
+            malformed_[index] = 0;
+         }
+      }
+
+      void set(message_type_id type, handler function) {
+         handlers_[type] = function;
+      }
+
+      // note: typed handler, called with the parsed message and returns
+      //       false to end the walk of the current stream
+      template <typename M, bool (*Handler)(Context &context, M &message)>
+      void set(message_type_id type) {
+         handlers_[type] = &dispatch_message<M, Handler>;
+      }
+
+      template <typename M, bool (*Handler)(Context &context, M &message)>
+      static dispatch_result dispatch_message(Context &context, bit_reader &reader) {
+         M message;
+         if (!message.serialize(reader)) {
+            return DISPATCH_MALFORMED;
+         }
+
+         return Handler(context, message) ? DISPATCH_CONTINUE : DISPATCH_STOP;
+      }
+
+      // note: returns false if the walk ended before the stream did
+      bool dispatch(Context &context, byte_stream &stream) {
+         bit_reader reader(stream);
+         uint8 type = MESSAGE_UNKNOWN;
+         while (reader.peek(type)) {
+            const handler function = type < MESSAGE_COUNT ? handlers_[type] : nullptr;
+            if (!function) {
+               unhandled_++;
+               return false;
+            }
+
+            const dispatch_result result = function(context, reader);
+            if (result == DISPATCH_MALFORMED) {
+               malformed_[type]++;
+               return false;
+            }
+
+            received_[type]++;
+            if (result == DISPATCH_STOP) {
+               return false;
+            }
+         }
+
+         return true;
+      }
+
+      uint64 received(message_type_id type) const {
+         return received_[type];
+      }
+
+      handler handlers_[MESSAGE_COUNT];
+      uint64 received_[MESSAGE_COUNT];
+      uint64 malformed_[MESSAGE_COUNT];
+      uint64 unhandled_;
+   };
+
+   static_assert(message_input_buffer::max_bits + message_ping::max_bits + message_pong::max_bits <= packet_builder::mtu * 8,
+                 "A tick's messages must fit in a single datagram");
+
 
 #if 0
    /* USAGE EXAMPLE */
@@ -0,0 +1,47 @@
+// rollback.h
+
+#ifndef ROLLBACK_H_INCLUDED
+#define ROLLBACK_H_INCLUDED
+
+#include "snapshot.h"
+
+namespace uu {
+   // note: ggpo style prediction on top of match::step. the local side
+   //       advances right away, the remote side is predicted to keep moving
+   //       the way it last did. a late remote input that differs from the
+   //       prediction restores the state saved before that frame and
+   //       resimulates up to the present. frames step through history_ so
+   //       shots are judged as the server judges them
+   struct rollback {
+      // note: frames the local side may run ahead of the last remote input
+      static constexpr uint32 max_prediction = 32;
+
+      // note: input history, also holds remote inputs that arrive early
+      static constexpr uint32 input_window = 256;
+
+      rollback();
+
+      void reset(sprite_sheet &sheet, texture &image);
+      bool can_advance() const;
+      uint32 remote_lead() const;
+      uint32 rewind() const;
+      void advance(const input &local);
+      bool add_remote_input(uint32 frame, const input &remote);
+      void resimulate();
+      input predict() const;
+
+      match state_;
+      match saved_[max_prediction];
+      collider_history history_;
+      input local_[input_window];
+      input remote_[input_window];
+      uint32 frame_;
+      uint32 remote_frame_;
+      bool mispredicted_;
+      uint32 mispredicted_frame_;
+   };
+
+   static_assert(rollback::max_prediction + collider_history::max_rewind_ticks < collider_history::capacity, "A resimulated frame has to find the tick it rewinds to");
+} // !uu
+
+#endif // !ROLLBACK_H_INCLUDED
@@ -0,0 +1,283 @@
+// snapshot.h
+
+#ifndef SNAPSHOT_H_INCLUDED
+#define SNAPSHOT_H_INCLUDED
+
+#include "match.h"
+#include "messages.h"
+
+namespace uu {
+   // note: positions travel as 16 bit fixed point with 1/16 pixel
+   //       resolution, offset so bullets leaving the screen stay positive
+   constexpr float snapshot_position_scale = 16.0f;
+   constexpr float snapshot_position_offset = 64.0f;
+   constexpr uint32 snapshot_position_bits = 16;
+   constexpr int32 snapshot_small_delta = 512;
+   constexpr uint32 snapshot_small_delta_bits = 10;
+   constexpr uint32 snapshot_lifetime_bits = 8;
+   constexpr uint32 snapshot_health_bits = 3;
+   constexpr uint32 snapshot_invader_count_bits = 6;
+
+   // note: one bit when value equals base, otherwise a short signed delta
+   //       for small moves or the full value. on read value holds base
+   template <typename S>
+   bool serialize_position(S &stream, uint16 &value, const uint16 base) {
+      bool changed = value != base;
+      if (!stream.serialize_bool(changed)) {
+         return false;
+      }
+      if (!changed) {
+         value = base;
+         return true;
+      }
+
+      int32 delta = (int32)value - (int32)base;
+      bool small = delta >= -snapshot_small_delta && delta < snapshot_small_delta;
+      if (!stream.serialize_bool(small)) {
+         return false;
+      }
+      if (small) {
+         if (!stream.serialize_int(delta, -snapshot_small_delta, snapshot_small_delta - 1)) {
+            return false;
+         }
+         value = (uint16)((int32)base + delta);
+         return true;
+      }
+
+      uint32 full = value;
+      if (!stream.serialize_bits(full, snapshot_position_bits)) {
+         return false;
+      }
+      value = (uint16)full;
+      return true;
+   }
+
+   // note: one bit when value equals base, otherwise the raw bits
+   template <typename S, typename T>
+   bool serialize_changed(S &stream, T &value, const T base, const uint32 bits) {
+      bool changed = value != base;
+      if (!stream.serialize_bool(changed)) {
+         return false;
+      }
+      if (!changed) {
+         value = base;
+         return true;
+      }
+
+      uint32 low = (uint32)value;
+      if (!stream.serialize_bits(low, bits < 32 ? bits : 32)) {
+         return false;
+      }
+      uint32 high = (uint32)((uint64)value >> 32);
+      if (bits > 32 && !stream.serialize_bits(high, bits - 32)) {
+         return false;
+      }
+      value = (T)(((uint64)high << 32) | low);
+      return true;
+   }
+
+   // note: the quantized world state of a match at one tick. invaders move
+   //       as one formation, so only the formation offset and a visibility
+   //       bitset per side are kept. fields of invisible bullets and
+   //       explosions are zero, so both ends hold bitwise equal baselines
+   struct snapshot {
+      static constexpr uint32 invader_count = invaders::capacity;
+      static constexpr uint32 bullet_count = bullets::capacity;
+      static constexpr uint32 explosion_count = explosions::capacity;
+      static_assert(bullet_count <= 32 && explosion_count <= 32, "Bullets and explosions are sent as 32 bit sets");
+      static constexpr uint32 block_count = 3;
+
+      static const snapshot &empty();
+
+      snapshot();
+
+      void capture(const match &m, uint32 tick);
+      void apply(match &m) const;
+
+      // note: every field is written as its change against base, on read
+      //       the snapshot has to hold a copy of base beforehand
+      template <typename S>
+      bool serialize(S &stream, const snapshot &base) {
+         for (uint32 side = 0; side < MATCH_SIDE_COUNT; side++) {
+            if (!(serialize_position(stream, formation_y_[side], base.formation_y_[side])
+               && serialize_changed(stream, formation_down_[side], base.formation_down_[side], 1)
+               && serialize_changed(stream, invaders_visible_[side], base.invaders_visible_[side], invader_count)
+               && serialize_changed(stream, invaders_alive_[side], base.invaders_alive_[side], snapshot_invader_count_bits)
+               && serialize_position(stream, ship_y_[side], base.ship_y_[side]))) {
+               return false;
+            }
+
+            for (uint32 index = 0; index < block_count; index++) {
+               if (!serialize_changed(stream, block_health_[side][index], base.block_health_[side][index], snapshot_health_bits)) {
+                  return false;
+               }
+            }
+         }
+
+         if (!(serialize_changed(stream, bullets_visible_, base.bullets_visible_, bullet_count)
+            && serialize_changed(stream, bullets_right_, base.bullets_right_, bullet_count))) {
+            return false;
+         }
+         for (uint32 index = 0; index < bullet_count; index++) {
+            if (!(bullets_visible_ & (1u << index))) {
+               bullet_x_[index] = 0;
+               bullet_y_[index] = 0;
+               continue;
+            }
+
+            if (!(serialize_position(stream, bullet_x_[index], base.bullet_x_[index])
+               && serialize_position(stream, bullet_y_[index], base.bullet_y_[index]))) {
+               return false;
+            }
+         }
+
+         if (!serialize_changed(stream, explosions_visible_, base.explosions_visible_, explosion_count)) {
+            return false;
+         }
+         for (uint32 index = 0; index < explosion_count; index++) {
+            if (!(explosions_visible_ & (1u << index))) {
+               explosion_x_[index] = 0;
+               explosion_y_[index] = 0;
+               explosion_lifetime_[index] = 0;
+               continue;
+            }
+
+            if (!(serialize_position(stream, explosion_x_[index], base.explosion_x_[index])
+               && serialize_position(stream, explosion_y_[index], base.explosion_y_[index])
+               && serialize_changed(stream, explosion_lifetime_[index], base.explosion_lifetime_[index], snapshot_lifetime_bits))) {
+               return false;
+            }
+         }
+
+         return true;
+      }
+
+      static constexpr uint32 max_position_bits = 2 + snapshot_position_bits;
+      static constexpr uint32 max_bits =
+         MATCH_SIDE_COUNT * (max_position_bits * 2 + 2 + (1 + invader_count) + (1 + snapshot_invader_count_bits) + block_count * (1 + snapshot_health_bits))
+         + 2 * (1 + bullet_count) + bullet_count * max_position_bits * 2
+         + (1 + explosion_count) + explosion_count * (max_position_bits * 2 + 1 + snapshot_lifetime_bits);
+
+      uint32 tick_;
+      uint16 formation_y_[MATCH_SIDE_COUNT];
+      uint8 formation_down_[MATCH_SIDE_COUNT];
+      uint64 invaders_visible_[MATCH_SIDE_COUNT];
+      uint8 invaders_alive_[MATCH_SIDE_COUNT];
+      uint16 ship_y_[MATCH_SIDE_COUNT];
+      uint8 block_health_[MATCH_SIDE_COUNT][block_count];
+      uint32 bullets_visible_;
+      uint32 bullets_right_;
+      uint16 bullet_x_[bullet_count];
+      uint16 bullet_y_[bullet_count];
+      uint32 explosions_visible_;
+      uint16 explosion_x_[explosion_count];
+      uint16 explosion_y_[explosion_count];
+      uint8 explosion_lifetime_[explosion_count];
+   };
+
+   // note: the snapshots last sent or received, keyed by tick. a sender
+   //       encodes against the newest one the peer acked, the receiver
+   //       finds the same one here to decode
+   struct snapshot_ring {
+      static constexpr uint32 capacity = 32;
+
+      snapshot_ring();
+
+      void reset();
+      void push(const snapshot &value);
+      const snapshot *find(uint32 tick) const;
+
+      bool valid_[capacity];
+      snapshot entries_[capacity];
+   };
+
+   // note: lag compensation, where the ships and invaders were over the
+   //       last capacity ticks. a rollback resimulating its oldest frame
+   //       still rewinds from there, so more ticks are kept than a single
+   //       rewind reaches. only quantized centers are kept, one per
+   //       ship and one per invader formation since invaders keep their
+   //       layout. extents never change, one table serves every entry.
+   //       rewind fills the hit targets of a past tick. the server and the
+   //       client rollback both step through step, so every simulation of
+   //       a match judges a shot the same way
+   struct collider_history {
+      static constexpr uint32 capacity = 64;
+      static constexpr uint32 max_rewind_ticks = 15;
+
+      enum kind {
+         KIND_SHIP,
+         KIND_INVADER,
+         KIND_COUNT,
+      };
+
+      struct entry {
+         uint32 tick_;
+         uint16 ships_[MATCH_SIDE_COUNT][2];
+         uint16 formations_[MATCH_SIDE_COUNT][2];
+      };
+
+      collider_history();
+
+      void reset();
+      void record(const match &m, uint32 tick);
+      bool rewind(const match &m, uint32 tick, hit_targets &result) const;
+
+      // note: steps m as tick, the bullets of each side are checked against
+      //       the world its input's rewind_ ticks back, then records it
+      void step(match &m, uint32 tick, const input &left, const input &right);
+
+      vector2 extents_[KIND_COUNT];
+      bool valid_[capacity];
+      entry entries_[capacity];
+   };
+
+   static_assert(collider_history::max_rewind_ticks == (1 << input_rewind_bits) - 1, "An input has to be able to ask for every rewind allowed");
+
+   inline void prepare_delta(bit_writer &, snapshot &, const snapshot &) {
+   }
+
+   inline void prepare_delta(bit_reader &, snapshot &value, const snapshot &base) {
+      value = base;
+   }
+
+   // note: a snapshot delta compressed against baselines_, the baseline is
+   //       sent as its age in ticks, zero for the empty snapshot
+   struct message_snapshot : message_header {
+      explicit message_snapshot(const snapshot_ring &baselines);
+      explicit message_snapshot(const snapshot_ring &baselines, const snapshot &value, uint32 baseline_tick);
+
+      template <typename S>
+      bool serialize(S &stream) {
+         if (!message_header::serialize(stream)) {
+            return false;
+         }
+
+         uint32 tick = snapshot_.tick_;
+         if (!(stream.serialize_varint(tick) && stream.serialize_varint(baseline_age_))) {
+            return false;
+         }
+
+         const snapshot *base = &snapshot::empty();
+         if (baseline_age_ > 0) {
+            base = baselines_.find(tick - baseline_age_);
+            if (!base) {
+               return false;
+            }
+         }
+
+         prepare_delta(stream, snapshot_, *base);
+         snapshot_.tick_ = tick;
+         return snapshot_.serialize(stream, *base);
+      }
+
+      static constexpr uint32 max_bits = message_header_bits + 2 * 40 + snapshot::max_bits;
+
+      const snapshot_ring &baselines_;
+      uint32 baseline_age_;
+      snapshot snapshot_;
+   };
+
+   static_assert(message_snapshot::max_bits <= packet_builder::mtu * 8, "A snapshot must fit in a single datagram");
+} // !uu
+
+#endif // !SNAPSHOT_H_INCLUDED
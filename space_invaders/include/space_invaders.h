@@ -8,7 +8,11 @@
 using namespace gamma;
 
 #include "entity.h"
+#include "match.h"
 #include "messages.h"
+#include "rollback.h"
+#include "jitter_buffer.h"
+#include "interpolation_buffer.h"
 #include "input.h"
 
 #include <vector>
@@ -21,45 +25,98 @@ namespace uu {
          GAME_STATE_PLAY,
       };
 
-      space_invaders();      
+      explicit space_invaders(const char *cmd_line);
       ~space_invaders();
 
       bool enter();
       void exit();
       bool update(const time &dt, const keyboard &kb);
-      void render(render_system &rs);
+      void render(render_system &rs, float alpha);
 
+	  void reset_entities();
+	  void disconnect();
+
+	  bool send_handshake(const time& now);
+	  bool receive_handshake(gamma::byte_stream& stream, const time& now);
 	  bool send_connection_request();
 	  bool send_connection_response();
-	  bool receive_connection_request(gamma::byte_stream& stream);
-	  bool receive_connection_response(gamma::byte_stream& stream);
-	  bool send_input(uu::message_input& inputMessage);
-	  bool receive_input(uu::message_input& inputMessage);
 	  bool send_input_buffer(uu::message_input_buffer& input_buffer_message);
-	  bool receive_input_buffer(uu::message_input_buffer& input_buffer_message);
 
+	  // note: message handlers, called by dispatcher_ with the parsed
+	  //       message, returning false ends the walk of the stream
+	  static bool receive_connection_request(space_invaders& game, uu::message_connection_request& message);
+	  static bool receive_connection_response(space_invaders& game, uu::message_connection_response& message);
+	  static bool receive_disconnect(space_invaders& game, uu::message_disconnect& message);
+	  static bool receive_input(space_invaders& game, uu::message_input& inputMessage);
+	  static bool receive_input_buffer(space_invaders& game, uu::message_input_buffer& input_buffer_message);
+	  static bool receive_ping(space_invaders& game, uu::message_ping& message);
+	  static bool receive_pong(space_invaders& game, uu::message_pong& message);
+	  void release_remote_inputs();
+	  void acknowledge_inputs(uint32 end);
+	  void set_network_profile(uint32 index);
+
+	  bool send_packet();
+	  void receive_packets();
+	  void receive_messages(gamma::byte_stream& stream);
+	  bool receive_packet(gamma::byte_stream*& stream);
+	  bool receive_batch();
+	  void release_batch();
 
+
+      // note: where the match server is, from the command line
+      string server_host_;
+      uint16 server_port_;
       ip_address remote_;
       udp_socket socket_;
 
+	  // note: simulated link in front of socket_, F1 cycles the profiles
+	  network_conditioner conditioner_;
+	  uint32 network_profile_;
+	  telemetry_log telemetry_;
+
       texture sprites_;
       sprite_sheet sprite_sheet_;
 
       state state_;
       time firetimer_;
-      bullets bullets_;
-      explosions explosions_;
-      invaders invaders_left_;
-      invaders invaders_right_;
-      spaceship ship_left_;
-      spaceship ship_right_;
-      blocks blocks_left_;
-      blocks blocks_right_;
+      rollback rollback_;
+      jitter_buffer jitter_;
+      interpolation_buffer interpolation_;
+      time accumulator_;
+
+      // note: the local ship before the last tick, render draws it alpha of
+      //       the way from here to where the tick left it
+      vector2 local_ship_from_;
 
 	  std::pair<bool, bool> connection_pair_;
 	  bool is_host_;
-	  time send_timer_;
 	  std::vector<input> input_buffer_;
+	  uint32 input_tick_;
+
+	  // note: input_tick_ is the tick of input_buffer_.front(), entries stay
+	  //       buffered until a packet carrying them has been acked
+	  connection connection_;
+	  clock_sync clock_;
+	  rate_controller rate_;
+	  message_dispatcher<space_invaders> dispatcher_;
+	  uint32 sent_input_tick_[connection::packet_window];
+
+	  // note: the cookie handshake ahead of the connection, handshake_ is
+	  //       the request or, once challenged, the response to resend until
+	  //       the first packet of the server arrives
+	  message_handshake handshake_;
+	  time handshake_sent_;
+	  time handshake_challenged_;
+	  bool handshake_done_;
+
+	  // note: datagrams pulled in with a single recv_batch call into pooled
+	  //       buffers, handed out one at a time by receive_packet
+	  static constexpr uint32 receive_batch_size = 16;
+	  packet_pool packets_;
+	  byte_stream receive_streams_[receive_batch_size];
+	  ip_address receive_addresses_[receive_batch_size];
+	  uint32 receive_count_;
+	  uint32 receive_index_;
    };
 } // !uu
 
@@ -13,8 +13,8 @@ namespace uu {
       }
    }
 
-   void blocks::update(sprite_sheet &sheet) {
-      for (int index = 0; index < _countof(entity_); index++) {
+   void blocks::update(sprite_sheet &) {
+      for (uint32 index = 0; index < countof(entity_); index++) {
          entity &e = entity_[index];
 
          e.sprite_.set_source(source_[block_max_health - health_[index]]);
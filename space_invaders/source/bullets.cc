@@ -3,38 +3,32 @@
 #include "entity.h"
 
 namespace uu {
-   constexpr float bullet_speed = 300.0f;
-
    bullets::bullets() 
+      : count_(0)
+      , overflows_(0)
    {
    }
 
    void bullets::update(const time &dt) {
-      for(int index = 0; index < _countof(entity_); index++) {
-         entity &e = entity_[index];
-         if (!e.visible_) {
-            continue;
-         }
+      const float seconds = dt.as_seconds();
+      for (uint32 index = 0; index < count_; index++) {
+         position_[index] = position_[index] + velocity_[index] * seconds;
+      }
 
-         e.position_ = e.position_ + direction_[index] * bullet_speed * dt.as_seconds();
-         e.sprite_.set_position(e.position_);
-         e.collider_.set_position(e.position_);
-         if (e.position_.x_ < -50.0f) {
-            e.visible_ = false;
-         }
-         else if (e.position_.x_ > 1100.0f) {
-            e.visible_ = false;
+      for (uint32 index = 0; index < count_;) {
+         const float x = position_[index].x_;
+         if (x < -50.0f || x > 1100.0f) {
+            despawn(index);
+            continue;
          }
+         index++;
       }
    }
 
    void bullets::render(render_system &rs) {
-      for (auto &e : entity_) {
-         if (!e.visible_) {
-            continue;
-         }
-
-         e.sprite_.render(rs);
+      for (uint32 index = 0; index < count_; index++) {
+         sprite_.set_position(position_[index]);
+         sprite_.render(rs);
       }
    }
 
@@ -42,29 +36,34 @@ namespace uu {
       rectangle source;
       sheet.get(BULLET, source);
 
-      for (auto &e : entity_) {
-         e.visible_ = false;
-         
-         e.sprite_.set_texture(image);
-         e.sprite_.set_source(source);
-         e.sprite_.set_size({ 24.0f, 4.0f });
+      sprite_.set_texture(image);
+      sprite_.set_source(source);
+      sprite_.set_size({ 24.0f, 4.0f });
+      extent_ = vector2(12.0f, 2.0f);
 
-         e.collider_.set_size({ 24.0f, 4.0f });
-         e.collider_.set_center({ 12.0f, 2.0f });
-      }
+      count_ = 0;
+      overflows_ = 0;
    }
 
-   void bullets::spawn(const vector2 &position, const vector2 &direction) {
-      for (int index = 0; index < _countof(entity_); index++) {
-         entity &e = entity_[index];
-         if (!e.visible_) {
-            direction_[index] = direction;
-            e.visible_ = true;
-            e.position_ = position;
-            e.sprite_.set_position(position);
-            e.collider_.set_position(position);
-            break;
-         }
+   bool bullets::spawn(const vector2 &position, const vector2 &direction) {
+      if (count_ == capacity) {
+         overflows_++;
+         return false;
       }
+
+      position_[count_] = position;
+      velocity_[count_] = direction * speed;
+      count_++;
+      return true;
+   }
+
+   void bullets::despawn(uint32 index) {
+      count_--;
+      position_[index] = position_[count_];
+      velocity_[index] = velocity_[count_];
+   }
+
+   collider bullets::collider_of(uint32 index) const {
+      return collider(position_[index] + extent_, extent_);
    }
 } // !uu
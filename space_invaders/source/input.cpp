@@ -3,12 +3,14 @@
 input::input()
 	: input_(0)
 	, dt_(0)
+	, rewind_(0)
 {
 }
 
 input::input(bool up, bool down, bool space, uint64_t dt)
 	: input_((up << 0) | (down << 1) | (space << 2))
 	, dt_(dt)
+	, rewind_(0)
 {
 }
 
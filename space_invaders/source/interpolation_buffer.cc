@@ -0,0 +1,113 @@
+// interpolation_buffer.cc
+
+#include "interpolation_buffer.h"
+
+namespace uu {
+   namespace {
+      // note: the client always plays the left side, the right one is remote
+      constexpr match_side remote_side = MATCH_SIDE_RIGHT;
+
+      vector2 lerp(const vector2 &from, const vector2 &to, float t) {
+         return from + (to - from) * t;
+      }
+
+      void place(entity &e, const vector2 &position) {
+         e.position_ = position;
+         e.sprite_.set_position(position);
+         e.collider_.set_position(position);
+      }
+   } // !anon
+
+   interpolation_buffer::interpolation_buffer() {
+      reset();
+   }
+
+   void interpolation_buffer::reset() {
+      count_ = 0;
+      newest_ = 0;
+      delay_ms_ = min_delay_ms;
+      underruns_ = 0;
+   }
+
+   void interpolation_buffer::push(const time &now, const match &m) {
+      // note: one sample per point in time, the latest state wins
+      if (count_ == 0 || samples_[newest_].time_ != now.tick_) {
+         newest_ = (newest_ + 1) % capacity;
+         count_ = count_ < capacity ? count_ + 1 : capacity;
+      }
+
+      sample &s = samples_[newest_];
+      s.time_ = now.tick_;
+      s.ship_ = m.ships_[remote_side].entity_.position_;
+      s.formation_ = m.invaders_[remote_side].position_[0];
+   }
+
+   void interpolation_buffer::set_jitter(float jitter_ms) {
+      // note: a tick to interpolate over plus twice the jitter, eased in so
+      //       the rendered time never jumps
+      float target = min_delay_ms + 2.0f * jitter_ms;
+      if (target > max_delay_ms) {
+         target = max_delay_ms;
+      }
+      delay_ms_ += (target - delay_ms_) / 16.0f;
+   }
+
+   void interpolation_buffer::apply(const time &now, match &m) {
+      sample at;
+      if (!sample_at(now.tick_ - (int64)delay_ms_, at)) {
+         return;
+      }
+
+      place(m.ships_[remote_side].entity_, at.ship_);
+
+      // note: the formation keeps its layout, it is only moved
+      invaders &formation = m.invaders_[remote_side];
+      const vector2 move = at.formation_ - formation.position_[0];
+      for (auto &position : formation.position_) {
+         position = position + move;
+      }
+   }
+
+   bool interpolation_buffer::sample_at(int64 at, sample &result) {
+      if (count_ == 0) {
+         return false;
+      }
+
+      // note: ran past the newest sample, keep the last motion going for
+      //       a little while and then hold still
+      const sample &newest = samples_[newest_];
+      if (at >= newest.time_) {
+         result = newest;
+         result.time_ = at;
+         if (at == newest.time_ || count_ < 2) {
+            return true;
+         }
+
+         underruns_++;
+         const sample &previous = samples_[(newest_ + capacity - 1) % capacity];
+         const int64 ahead = at - newest.time_ < max_extrapolation_ms ? at - newest.time_ : max_extrapolation_ms;
+         const float t = (float)ahead / (float)(newest.time_ - previous.time_);
+         result.ship_ = lerp(newest.ship_, newest.ship_ + (newest.ship_ - previous.ship_), t);
+         result.formation_ = lerp(newest.formation_, newest.formation_ + (newest.formation_ - previous.formation_), t);
+         return true;
+      }
+
+      for (uint32 index = 1; index < count_; index++) {
+         const sample &older = samples_[(newest_ + capacity - index) % capacity];
+         if (older.time_ > at) {
+            continue;
+         }
+
+         const sample &newer = samples_[(newest_ + capacity - index + 1) % capacity];
+         const float t = (float)(at - older.time_) / (float)(newer.time_ - older.time_);
+         result.time_ = at;
+         result.ship_ = lerp(older.ship_, newer.ship_, t);
+         result.formation_ = lerp(older.formation_, newer.formation_, t);
+         return true;
+      }
+
+      // note: older than anything kept, show the oldest
+      result = samples_[(newest_ + capacity - count_ + 1) % capacity];
+      return true;
+   }
+} // !uu
@@ -20,11 +20,9 @@ namespace uu {
          return;
       }
 
-      vector2 move(0.0f, invader_speed * direction_.y_ * dt.as_seconds());
-      for (auto &e : entity_) {
-         e.position_ = e.position_ + move;
-         e.sprite_.set_position(e.position_);
-         e.collider_.set_position(e.position_);
+      const vector2 move(0.0f, invader_speed * direction_.y_ * dt.as_seconds());
+      for (uint32 index = 0; index < capacity; index++) {
+         position_[index] = position_[index] + move;
       }
 
       calculate_area();
@@ -36,12 +34,14 @@ namespace uu {
       }
 
       //rs.draw(0xffff00ff, area_);
-      for (auto &e : entity_) {
-         if (!e.visible_) {
+      for (uint32 index = 0; index < capacity; index++) {
+         if (!alive_[index]) {
             continue;
          }
 
-         e.sprite_.render(rs);
+         sprite &s = sprites_[index / row_count];
+         s.set_position(position_[index]);
+         s.render(rs);
       }
    }
 
@@ -50,7 +50,8 @@ namespace uu {
    }
 
    void invaders::reset(sprite_sheet &sheet, texture &image, bool left) {
-      entity_count_ = _countof(entity_);
+      entity_count_ = capacity;
+      extent_ = vector2(invader_width * 0.5f, invader_height * 0.5f);
 
       const int id = left ? 0 : 1;
       const int sprites[2][5] =
@@ -59,10 +60,15 @@ namespace uu {
          { RIGHT_ENEMY_1, RIGHT_ENEMY_2, RIGHT_ENEMY_2, RIGHT_ENEMY_3, RIGHT_ENEMY_3 },
       };
 
-      const int col_count = 5;
-      const int row_count = 7;
-      int index = 0;
-      for (auto &e : entity_) {
+      for (uint32 col = 0; col < countof(sprites_); col++) {
+         rectangle source;
+         sheet.get(sprites[id][col], source);
+         sprites_[col].set_texture(image);
+         sprites_[col].set_source(source);
+         sprites_[col].set_size({ invader_width, invader_height });
+      }
+
+      for (uint32 index = 0; index < capacity; index++) {
          const int row = (index % row_count);
          const float y = row * invader_height;
          const float y_offset = invader_spacing * row;
@@ -71,21 +77,9 @@ namespace uu {
          const float x = col * invader_width;
          const float x_offset = invader_spacing * col;
 
-         e.position_ = vector2(x + x_offset, y + y_offset);
-         e.position_ = e.position_ + offset_;
-
-         rectangle source;
-         sheet.get(sprites[id][col], source);
-         e.sprite_.set_texture(image);
-         e.sprite_.set_source(source);
-         e.sprite_.set_size({ invader_width, invader_height });
-         e.sprite_.set_position(e.position_);
-         
-         e.collider_.set_size({ invader_width, invader_height });
-         e.collider_.set_center(e.position_ + vector2(invader_width * 0.5f, invader_height * 0.5f));
-         e.collider_.set_position(e.position_);
-
-         index++;
+         alive_[index] = true;
+         position_[index] = vector2(x + x_offset, y + y_offset);
+         position_[index] = position_[index] + offset_;
       }
 
       calculate_area();
@@ -94,23 +88,25 @@ namespace uu {
    void invaders::calculate_area() {
       vector2 min(9999.0f, 9999.0f);
       vector2 max;
-      for (auto &e : entity_) {
-         if (!e.visible_) { 
+      const vector2 size = extent_ * 2.0f;
+      for (uint32 index = 0; index < capacity; index++) {
+         if (!alive_[index]) { 
             continue; 
          }
 
-         if (min.x_ > e.collider_.min().x_) {
-            min.x_ = e.collider_.min().x_;
+         const vector2 &position = position_[index];
+         if (min.x_ > position.x_) {
+            min.x_ = position.x_;
          }
-         if (min.y_ > e.collider_.min().y_) {
-            min.y_ = e.collider_.min().y_;
+         if (min.y_ > position.y_) {
+            min.y_ = position.y_;
          }
 
-         if (max.x_ < e.collider_.max().x_) {
-            max.x_ = e.collider_.max().x_;
+         if (max.x_ < position.x_ + size.x_) {
+            max.x_ = position.x_ + size.x_;
          }
-         if (max.y_ < e.collider_.max().y_) {
-            max.y_ = e.collider_.max().y_;
+         if (max.y_ < position.y_ + size.y_) {
+            max.y_ = position.y_ + size.y_;
          }
       }
 
@@ -129,17 +125,21 @@ namespace uu {
 
    void invaders::remove_random() {
 #if 0
-      int index = (int)random::range(0, _countof(entity_));
-      entity_[index].visible_ = false;
+      int index = (int)random::range(0, capacity);
+      alive_[index] = false;
 #else
-      for (int counter = 0; counter < _countof(entity_); counter++) {
-         int index = (int)random::range(0, _countof(entity_));
-         if (entity_[index].visible_) {
-            entity_[index].visible_ = false;
+      for (uint32 counter = 0; counter < capacity; counter++) {
+         int index = (int)random::range(0, capacity);
+         if (alive_[index]) {
+            alive_[index] = false;
             entity_count_--;
             break;
          }
       }
 #endif
    }
+
+   collider invaders::collider_of(uint32 index) const {
+      return collider(position_[index] + extent_, extent_);
+   }
 } // !uu
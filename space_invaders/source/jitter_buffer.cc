@@ -0,0 +1,119 @@
+// jitter_buffer.cc
+
+#include "jitter_buffer.h"
+
+namespace uu {
+   jitter_buffer::jitter_buffer() {
+      reset();
+   }
+
+   void jitter_buffer::reset() {
+      for (auto &valid : valid_) {
+         valid = false;
+      }
+      next_tick_ = 0;
+      newest_tick_ = 0;
+      credit_ = 0;
+      playing_ = false;
+
+      has_arrival_ = false;
+      arrival_tick_ = 0;
+      transit_ = 0;
+      jitter_ms_ = 0.0f;
+      burst_ = 1.0f;
+      target_depth_ = 1;
+
+      underruns_ = 0;
+      overflows_ = 0;
+   }
+
+   bool jitter_buffer::push(uint32 tick, const input &value) {
+      // note: resends carry ticks that were already released
+      if ((int32)(tick - next_tick_) < 0) {
+         return true;
+      }
+
+      if ((int32)(tick - next_tick_) >= (int32)capacity) {
+         overflows_++;
+         return false;
+      }
+
+      inputs_[tick % capacity] = value;
+      valid_[tick % capacity] = true;
+      if ((int32)(tick + 1 - newest_tick_) > 0) {
+         newest_tick_ = tick + 1;
+      }
+
+      return true;
+   }
+
+   void jitter_buffer::arrived(const time &now) {
+      if (has_arrival_ && (int32)(newest_tick_ - arrival_tick_) <= 0) {
+         return;
+      }
+
+      // note: transit relative to the remote tick clock, only its variation
+      //       matters. rfc 3550 style smoothing
+      const int64 transit = now.tick_ - (int64)newest_tick_ * match::tick_ms;
+      if (has_arrival_) {
+         const int64 delta = transit > transit_ ? transit - transit_ : transit_ - transit;
+         jitter_ms_ += ((float)delta - jitter_ms_) / 16.0f;
+         burst_ += ((float)(newest_tick_ - arrival_tick_) - burst_) / 16.0f;
+      }
+      transit_ = transit;
+      arrival_tick_ = newest_tick_;
+      has_arrival_ = true;
+
+      const uint32 target = (uint32)(burst_ + 0.5f) + (uint32)(2.0f * jitter_ms_ / (float)match::tick_ms + 0.5f);
+      target_depth_ = target < 1 ? 1 : (target > max_depth ? max_depth : target);
+   }
+
+   void jitter_buffer::tick() {
+      const uint32 buffered = depth();
+      if (!playing_) {
+         playing_ = buffered >= target_depth_;
+         credit_ = playing_ ? 1 : 0;
+         return;
+      }
+
+      // note: ran dry, refill up to the target before releasing again
+      if (!valid_[next_tick_ % capacity]) {
+         underruns_++;
+         playing_ = false;
+         credit_ = 0;
+         return;
+      }
+
+      // note: drain one extra tick while above target, the depth shrinks
+      //       back down once the jitter settles
+      credit_ = buffered > target_depth_ + 1 ? 2 : 1;
+   }
+
+   void jitter_buffer::flush() {
+      credit_ = capacity;
+   }
+
+   bool jitter_buffer::pop(uint32 &tick, input &value) {
+      const uint32 slot = next_tick_ % capacity;
+      if (credit_ == 0 || !valid_[slot]) {
+         return false;
+      }
+
+      tick = next_tick_;
+      value = inputs_[slot];
+      valid_[slot] = false;
+      next_tick_++;
+      credit_--;
+
+      return true;
+   }
+
+   uint32 jitter_buffer::depth() const {
+      uint32 count = 0;
+      while (count < capacity && valid_[(next_tick_ + count) % capacity]) {
+         count++;
+      }
+
+      return count;
+   }
+} // !uu
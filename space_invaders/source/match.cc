@@ -0,0 +1,191 @@
+// match.cc
+
+#include "match.h"
+
+namespace uu {
+   namespace {
+      struct contact {
+         vector2 position_;
+      };
+
+      // note: bullets fly away from the ship that fired them
+      match_side shooter_of(const bullets &b, uint32 index) {
+         return b.velocity_[index].x_ > 0.0f ? MATCH_SIDE_LEFT : MATCH_SIDE_RIGHT;
+      }
+
+      // note: a bullet that hits is despawned, the last live one takes its
+      //       slot and is checked next
+      void check_collision(bullets &b, invaders &i, int side, const hit_targets *const (&rewound)[MATCH_SIDE_COUNT], dynamic_array<contact> &c) {
+         for (uint32 bullet_index = 0; bullet_index < b.count_;) {
+            // note: only invaders still alive now can be hit where they were
+            const collider bullet = b.collider_of(bullet_index);
+            const hit_targets *targets = rewound[shooter_of(b, bullet_index)];
+            bool hit = false;
+            for (uint32 invader_index = 0; invader_index < invaders::capacity; invader_index++) {
+               if (!i.alive_[invader_index]) {
+                  continue;
+               }
+
+               const collider target = targets ? targets->invaders_[side][invader_index] : i.collider_of(invader_index);
+               if (collider::overlap(bullet, target)) {
+                  i.alive_[invader_index] = false;
+
+                  contact cc;
+                  cc.position_ = i.position_[invader_index];
+                  c.push_back(cc);
+
+                  hit = true;
+                  break;
+               }
+            }
+
+            if (hit) {
+               b.despawn(bullet_index);
+               continue;
+            }
+            bullet_index++;
+         }
+      }
+
+      void check_collision(bullets &bu, blocks &bl, dynamic_array<contact> &c) {
+         for (uint32 bullet_index = 0; bullet_index < bu.count_;) {
+            const collider bullet = bu.collider_of(bullet_index);
+            bool hit = false;
+            for (uint32 block_index = 0; block_index < countof(bl.entity_); block_index++) {
+               entity &block = bl.entity_[block_index];
+               if (!block.visible_) {
+                  continue;
+               }
+
+               if (collider::overlap(bullet, block.collider_)) {
+                  bl.health_[block_index]--;
+                  if (!bl.health_[block_index]) {
+                     block.visible_ = false;
+                  }
+
+                  const float direction = bu.velocity_[bullet_index].x_ > 0.0f ? 1.0f : -1.0f;
+                  contact cc;
+                  cc.position_ = bu.position_[bullet_index] + vector2(0.0f, -24.0f * direction);
+                  c.push_back(cc);
+
+                  hit = true;
+                  break;
+               }
+            }
+
+            if (hit) {
+               bu.despawn(bullet_index);
+               continue;
+            }
+            bullet_index++;
+         }
+      }
+
+      void check_collision(bullets &b, spaceship &ship, int side, const hit_targets *const (&rewound)[MATCH_SIDE_COUNT], dynamic_array<contact> &c) {
+         for (uint32 bullet_index = 0; bullet_index < b.count_; bullet_index++) {
+            const hit_targets *targets = rewound[shooter_of(b, bullet_index)];
+            const collider &target = targets ? targets->ships_[side] : ship.entity_.collider_;
+            if (collider::overlap(b.collider_of(bullet_index), target)) {
+               contact cc;
+               cc.position_ = b.position_[bullet_index] - vector2(0.0f, 26.0f);
+               c.push_back(cc);
+
+               b.despawn(bullet_index);
+               break;
+            }
+         }
+      }
+   } // !anon
+
+   match::match()
+      : sheet_(nullptr)
+      , invaders_{ { { 200.0f, 10.0f }, { -1.0f, 1.0f } },
+                   { { 1024.0f - 392.0f, 118.0f }, { 1.0f, -1.0f } } }
+      , ships_{ { { 10.0f, 512.0f * 0.5f - 16.0f }, { 32.0f, 24.0f } },
+                { { 1024.0f - 48.0f, 512.0f * 0.5f - 16.0f }, { -32.0f, 24.0f } } }
+      , blocks_{ { { 1024, 512 } }, { { 1024, 512 } } }
+   {
+   }
+
+   void match::reset(sprite_sheet &sheet, texture &image) {
+      sheet_ = &sheet;
+      bullets_.reset(sheet, image);
+      explosions_.reset(sheet, image);
+      invaders_[MATCH_SIDE_LEFT].reset(sheet, image, true);
+      invaders_[MATCH_SIDE_RIGHT].reset(sheet, image, false);
+      ships_[MATCH_SIDE_LEFT].reset(sheet, image, true);
+      ships_[MATCH_SIDE_RIGHT].reset(sheet, image, false);
+      blocks_[MATCH_SIDE_LEFT].reset(sheet, image, LEFT_BASE_DMG0);
+      blocks_[MATCH_SIDE_RIGHT].reset(sheet, image, RIGHT_BASE_DMG0);
+   }
+
+   void match::step(const input &left, const input &right) {
+      const hit_targets *const current[MATCH_SIDE_COUNT] = {};
+      step(left, right, current);
+   }
+
+   void match::step(const input &left, const input &right, const hit_targets *const (&rewound)[MATCH_SIDE_COUNT]) {
+      apply_input(MATCH_SIDE_LEFT, left);
+      apply_input(MATCH_SIDE_RIGHT, right);
+      update(time(tick_ms), rewound);
+   }
+
+   void match::apply_input(match_side side, const input &input) {
+      spaceship &ship = ships_[side];
+      ship.direction_ = {};
+      if (input.has_up()) {
+         ship.direction_.y_ -= 1.0f;
+      }
+      if (input.has_down()) {
+         ship.direction_.y_ += 1.0f;
+      }
+      if (input.has_space()) {
+         const vector2 direction(side == MATCH_SIDE_LEFT ? 1.0f : -1.0f, 0.0f);
+         bullets_.spawn(ship.entity_.position_ + ship.offset_, direction);
+      }
+   }
+
+   void match::update(const time &dt) {
+      const hit_targets *const current[MATCH_SIDE_COUNT] = {};
+      update(dt, current);
+   }
+
+   void match::update(const time &dt, const hit_targets *const (&rewound)[MATCH_SIDE_COUNT]) {
+      for (int side = 0; side < MATCH_SIDE_COUNT; side++) {
+         invaders_[side].update(dt);
+         ships_[side].update(dt);
+         blocks_[side].update(*sheet_);
+      }
+      bullets_.update(dt);
+
+      dynamic_array<contact> contacts;
+      for (int side = 0; side < MATCH_SIDE_COUNT; side++) {
+         check_collision(bullets_, blocks_[side], contacts);
+      }
+      for (int side = 0; side < MATCH_SIDE_COUNT; side++) {
+         check_collision(bullets_, invaders_[side], side, rewound, contacts);
+      }
+      for (int side = 0; side < MATCH_SIDE_COUNT; side++) {
+         check_collision(bullets_, ships_[side], side, rewound, contacts);
+      }
+      for (auto &c : contacts) {
+         explosions_.spawn(c.position_);
+      }
+
+      explosions_.update(dt);
+   }
+
+   void match::render(render_system &rs) {
+      for (int side = 0; side < MATCH_SIDE_COUNT; side++) {
+         invaders_[side].render(rs);
+      }
+      bullets_.render(rs);
+      explosions_.render(rs);
+      for (int side = 0; side < MATCH_SIDE_COUNT; side++) {
+         ships_[side].render(rs);
+      }
+      for (int side = 0; side < MATCH_SIDE_COUNT; side++) {
+         blocks_[side].render(rs);
+      }
+   }
+} // !uu
@@ -62,22 +62,150 @@ namespace uu {
    bool message_input::has_space() const {
       return (input_ & (1 << 2)) > 0;
    }
+
    message_input_buffer::message_input_buffer()
-	   : input_buffer_{}
-	   , size_(buffer_size)
+	   : message_header(MESSAGE_INPUT_BUFFER)
+	   , version_(input_buffer_version)
+	   , base_tick_(0)
+   {
+   }
+
+   message_input_buffer::message_input_buffer(uint32 base_tick, const std::vector<input>& input_buffer)
+	   : message_header(MESSAGE_INPUT_BUFFER)
+	   , version_(input_buffer_version)
+	   , base_tick_(base_tick)
    {
+	   // note: a sender that fell far behind sends the oldest entries and
+	   //       keeps the rest for later messages. the receiver needs every
+	   //       tick in order, and an ack only retires what was sent
+	   auto end = max_input_buffer_count < input_buffer.size() ?
+		   input_buffer.begin() + max_input_buffer_count
+		   : input_buffer.end();
+	   input_buffer_.assign(input_buffer.begin(), end);
    }
-   message_input_buffer::message_input_buffer(const std::vector<input>& input_buffer)
-	   : input_buffer_{}
-	   , size_(buffer_size)
+
+   uint32 message_input_buffer::run_length(uint32 index) const
    {
-	   auto it = buffer_size < input_buffer.size() ? 
-		   input_buffer.end() - buffer_size
-		   : input_buffer.begin();
-	   for (it; it != input_buffer.end(); ++it)
+	   const input& first = input_buffer_[index];
+	   uint32 run = 1;
+	   while (index + run < input_buffer_.size())
 	   {
-		   int64_t index = it - input_buffer.begin();
-		   input_buffer_[index] = *it;
+		   const input& next = input_buffer_[index + run];
+		   if (next.input_ != first.input_ || next.rewind_ != first.rewind_ || next.dt_ != first.dt_)
+			   break;
+		   ++run;
 	   }
+	   return run;
+   }
+
+   message_ping::message_ping()
+      : message_header(MESSAGE_PING)
+      , time_(0)
+   {
+   }
+
+   message_ping::message_ping(uint64 time)
+      : message_header(MESSAGE_PING)
+      , time_(time)
+   {
+   }
+
+   message_pong::message_pong()
+      : message_header(MESSAGE_PONG)
+      , echo_(0)
+      , time_(0)
+      , hold_(0)
+   {
+   }
+
+   message_pong::message_pong(uint64 echo, uint64 time, uint16 hold)
+      : message_header(MESSAGE_PONG)
+      , echo_(echo)
+      , time_(time)
+      , hold_(hold)
+   {
+   }
+
+   message_handshake::message_handshake()
+      : message_header(MESSAGE_UNKNOWN)
+      , protocol_(protocol_id)
+      , issued_(0)
+      , cookie_(0)
+   {
+   }
+
+   message_handshake::message_handshake(message_type_id type, uint32 issued, uint64 cookie)
+      : message_header(type)
+      , protocol_(protocol_id)
+      , issued_(issued)
+      , cookie_(cookie)
+   {
+   }
+
+   bool message_handshake::is_valid() const {
+      return protocol_ == protocol_id &&
+         (type_ == MESSAGE_HANDSHAKE_REQUEST ||
+          type_ == MESSAGE_HANDSHAKE_CHALLENGE ||
+          type_ == MESSAGE_HANDSHAKE_RESPONSE);
+   }
+
+   message_spectate::message_spectate()
+      : message_header(MESSAGE_SPECTATE)
+      , protocol_(protocol_id)
+      , issued_(0)
+      , cookie_(0)
+      , match_(~0u)
+   {
+   }
+
+   message_spectate::message_spectate(uint32 issued, uint64 cookie, uint32 match)
+      : message_header(MESSAGE_SPECTATE)
+      , protocol_(protocol_id)
+      , issued_(issued)
+      , cookie_(cookie)
+      , match_(match)
+   {
+   }
+
+   bool message_spectate::is_valid() const {
+      return protocol_ == protocol_id && type_ == MESSAGE_SPECTATE;
+   }
+
+   bool write_handshake(byte_stream &stream, message_handshake &message) {
+      return write_datagram(stream, message);
+   }
+
+   bool read_handshake(byte_stream &stream, message_handshake &message) {
+      return read_datagram(stream, message);
+   }
+
+   bool write_spectate(byte_stream &stream, message_spectate &message) {
+      return write_datagram(stream, message);
+   }
+
+   bool read_spectate(byte_stream &stream, message_spectate &message) {
+      return read_datagram(stream, message);
+   }
+
+   void send_clock_messages(connection &c, clock_sync &clock, const time &now) {
+      if (clock.should_ping(now)) {
+         message_ping ping((uint64)now.tick_);
+         c.send_unreliable(ping);
+      }
+
+      int64 echo = 0;
+      int64 hold = 0;
+      if (clock.take_pong(now, echo, hold)) {
+         message_pong pong((uint64)echo, (uint64)now.tick_, (uint16)(hold < 0xffff ? hold : 0xffff));
+         c.send_unreliable(pong);
+      }
+   }
+
+   void receive_ping(clock_sync &clock, const message_ping &message, const time &now) {
+      clock.on_ping(now, (int64)message.time_);
+   }
+
+   void receive_pong(clock_sync &clock, const message_pong &message, const time &now) {
+      clock.on_pong(now, (int64)message.echo_, (int64)message.time_, (int64)message.hold_);
    }
 } // !uu
@@ -0,0 +1,105 @@
+// rollback.cc
+
+#include "rollback.h"
+
+namespace uu {
+   namespace {
+      constexpr uint8 input_space_bit = 1 << 2;
+   } // !anon
+
+   rollback::rollback()
+      : frame_(0)
+      , remote_frame_(0)
+      , mispredicted_(false)
+      , mispredicted_frame_(0)
+   {
+   }
+
+   void rollback::reset(sprite_sheet &sheet, texture &image) {
+      state_.reset(sheet, image);
+      history_.reset();
+      frame_ = 0;
+      remote_frame_ = 0;
+      mispredicted_ = false;
+      mispredicted_frame_ = 0;
+   }
+
+   bool rollback::can_advance() const {
+      return (int32)(frame_ - remote_frame_) < (int32)max_prediction;
+   }
+
+   uint32 rollback::remote_lead() const {
+      return (int32)(remote_frame_ - frame_) > 0 ? remote_frame_ - frame_ : 0;
+   }
+
+   uint32 rollback::rewind() const {
+      // note: frames from remote_frame_ on show a predicted remote side, a
+      //       shot fired now was aimed at the world of the last one known
+      const uint32 ahead = (int32)(frame_ - remote_frame_) >= 0 ? frame_ + 1 - remote_frame_ : 0;
+      return ahead < collider_history::max_rewind_ticks ? ahead : collider_history::max_rewind_ticks;
+   }
+
+   void rollback::advance(const input &local) {
+      const uint32 slot = frame_ % input_window;
+      local_[slot] = local;
+      if ((int32)(frame_ - remote_frame_) >= 0) {
+         remote_[slot] = predict();
+      }
+
+      saved_[frame_ % max_prediction] = state_;
+      history_.step(state_, frame_, local_[slot], remote_[slot]);
+      frame_++;
+   }
+
+   bool rollback::add_remote_input(uint32 frame, const input &remote) {
+      // note: remote inputs come in order, anything past the history would
+      //       overwrite frames that are still needed
+      if (frame != remote_frame_ || (int32)(frame - frame_) >= (int32)(input_window - max_prediction)) {
+         return false;
+      }
+
+      const uint32 slot = frame % input_window;
+      if ((int32)(frame - frame_) < 0 &&
+          (remote_[slot].input_ != remote.input_ || remote_[slot].rewind_ != remote.rewind_)) {
+         if (!mispredicted_ || (int32)(frame - mispredicted_frame_) < 0) {
+            mispredicted_frame_ = frame;
+         }
+         mispredicted_ = true;
+      }
+
+      remote_[slot] = remote;
+      remote_frame_++;
+
+      return true;
+   }
+
+   void rollback::resimulate() {
+      if (!mispredicted_) {
+         return;
+      }
+      mispredicted_ = false;
+
+      // note: frames past the newest remote input are predicted again from it
+      state_ = saved_[mispredicted_frame_ % max_prediction];
+      for (uint32 frame = mispredicted_frame_; frame != frame_; frame++) {
+         const uint32 slot = frame % input_window;
+         if ((int32)(frame - remote_frame_) >= 0) {
+            remote_[slot] = predict();
+         }
+
+         saved_[frame % max_prediction] = state_;
+         history_.step(state_, frame, local_[slot], remote_[slot]);
+      }
+   }
+
+   input rollback::predict() const {
+      if (remote_frame_ == 0) {
+         return input();
+      }
+
+      // note: keep moving, but never fire a shot the remote did not take
+      input result = remote_[(remote_frame_ - 1) % input_window];
+      result.input_ &= (uint8)~input_space_bit;
+      return result;
+   }
+} // !uu
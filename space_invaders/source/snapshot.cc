@@ -0,0 +1,253 @@
+// snapshot.cc
+
+#include "snapshot.h"
+
+#include <string.h>
+
+namespace uu {
+   namespace {
+      uint16 quantize_position(float value) {
+         const float scaled = (value + snapshot_position_offset) * snapshot_position_scale + 0.5f;
+         if (scaled <= 0.0f) {
+            return 0;
+         }
+         if (scaled >= 65535.0f) {
+            return 0xffff;
+         }
+         return (uint16)scaled;
+      }
+
+      float dequantize_position(uint16 value) {
+         return (float)value / snapshot_position_scale - snapshot_position_offset;
+      }
+
+      vector2 dequantize_position(const uint16 (&value)[2]) {
+         return vector2(dequantize_position(value[0]), dequantize_position(value[1]));
+      }
+
+      void quantize_position(uint16 (&result)[2], const vector2 &value) {
+         result[0] = quantize_position(value.x_);
+         result[1] = quantize_position(value.y_);
+      }
+
+      void place(entity &e, const vector2 &position) {
+         e.position_ = position;
+         e.sprite_.set_position(position);
+         e.collider_.set_position(position);
+      }
+   } // !anon
+
+   const snapshot &snapshot::empty() {
+      static const snapshot result;
+      return result;
+   }
+
+   snapshot::snapshot() {
+      memset(this, 0, sizeof(*this));
+   }
+
+   void snapshot::capture(const match &m, uint32 tick) {
+      memset(this, 0, sizeof(*this));
+      tick_ = tick;
+
+      for (uint32 side = 0; side < MATCH_SIDE_COUNT; side++) {
+         const invaders &formation = m.invaders_[side];
+         formation_y_[side] = quantize_position(formation.position_[0].y_);
+         formation_down_[side] = formation.direction_.y_ > 0.0f ? 1 : 0;
+         for (uint32 index = 0; index < invader_count; index++) {
+            if (formation.alive_[index]) {
+               invaders_visible_[side] |= 1ull << index;
+            }
+         }
+         invaders_alive_[side] = (uint8)formation.entity_count_;
+
+         ship_y_[side] = quantize_position(m.ships_[side].entity_.position_.y_);
+
+         for (uint32 index = 0; index < block_count; index++) {
+            const int health = m.blocks_[side].health_[index];
+            block_health_[side][index] = (uint8)(health > 0 ? health : 0);
+         }
+      }
+
+      const bullets &b = m.bullets_;
+      for (uint32 index = 0; index < b.count_; index++) {
+         bullets_visible_ |= 1u << index;
+         if (b.velocity_[index].x_ > 0.0f) {
+            bullets_right_ |= 1u << index;
+         }
+         bullet_x_[index] = quantize_position(b.position_[index].x_);
+         bullet_y_[index] = quantize_position(b.position_[index].y_);
+      }
+
+      const explosions &e = m.explosions_;
+      for (uint32 index = 0; index < e.count_; index++) {
+         const int64 lifetime = e.lifetime_[index].tick_;
+         explosions_visible_ |= 1u << index;
+         explosion_x_[index] = quantize_position(e.position_[index].x_);
+         explosion_y_[index] = quantize_position(e.position_[index].y_);
+         explosion_lifetime_[index] = (uint8)(lifetime < 0 ? 0 : lifetime > 0xff ? 0xff : lifetime);
+      }
+   }
+
+   void snapshot::apply(match &m) const {
+      for (uint32 side = 0; side < MATCH_SIDE_COUNT; side++) {
+         // note: the formation keeps its layout, it is only moved
+         invaders &formation = m.invaders_[side];
+         const float move = dequantize_position(formation_y_[side]) - formation.position_[0].y_;
+         for (uint32 index = 0; index < invader_count; index++) {
+            formation.alive_[index] = (invaders_visible_[side] & (1ull << index)) != 0;
+            formation.position_[index].y_ += move;
+         }
+         formation.entity_count_ = invaders_alive_[side];
+         formation.calculate_area();
+         formation.direction_.y_ = formation_down_[side] ? 1.0f : -1.0f;
+
+         entity &ship = m.ships_[side].entity_;
+         place(ship, vector2(ship.position_.x_, dequantize_position(ship_y_[side])));
+
+         blocks &b = m.blocks_[side];
+         for (uint32 index = 0; index < block_count; index++) {
+            b.health_[index] = block_health_[side][index];
+            b.entity_[index].visible_ = b.health_[index] > 0;
+         }
+      }
+
+      // note: a sender fills the bitsets from the front, any gap left is
+      //       closed up again here
+      bullets &b = m.bullets_;
+      b.count_ = 0;
+      for (uint32 index = 0; index < bullet_count; index++) {
+         if (!(bullets_visible_ & (1u << index))) {
+            continue;
+         }
+
+         b.velocity_[b.count_] = vector2((bullets_right_ & (1u << index)) ? bullets::speed : -bullets::speed, 0.0f);
+         b.position_[b.count_] = vector2(dequantize_position(bullet_x_[index]), dequantize_position(bullet_y_[index]));
+         b.count_++;
+      }
+
+      explosions &e = m.explosions_;
+      e.count_ = 0;
+      for (uint32 index = 0; index < explosion_count; index++) {
+         if (!(explosions_visible_ & (1u << index))) {
+            continue;
+         }
+
+         e.lifetime_[e.count_] = time(explosion_lifetime_[index]);
+         e.position_[e.count_] = vector2(dequantize_position(explosion_x_[index]), dequantize_position(explosion_y_[index]));
+         e.count_++;
+      }
+   }
+
+   snapshot_ring::snapshot_ring() {
+      reset();
+   }
+
+   void snapshot_ring::reset() {
+      for (auto &valid : valid_) {
+         valid = false;
+      }
+   }
+
+   void snapshot_ring::push(const snapshot &value) {
+      // note: a late snapshot must not evict a newer one sharing its slot
+      const uint32 index = value.tick_ % capacity;
+      if (valid_[index] && (int32)(value.tick_ - entries_[index].tick_) < 0) {
+         return;
+      }
+
+      valid_[index] = true;
+      entries_[index] = value;
+   }
+
+   const snapshot *snapshot_ring::find(uint32 tick) const {
+      const uint32 index = tick % capacity;
+      if (!valid_[index] || entries_[index].tick_ != tick) {
+         return nullptr;
+      }
+
+      return &entries_[index];
+   }
+
+   collider_history::collider_history() {
+      reset();
+   }
+
+   void collider_history::reset() {
+      for (auto &valid : valid_) {
+         valid = false;
+      }
+   }
+
+   void collider_history::record(const match &m, uint32 tick) {
+      extents_[KIND_SHIP] = m.ships_[MATCH_SIDE_LEFT].entity_.collider_.extend_;
+      extents_[KIND_INVADER] = m.invaders_[MATCH_SIDE_LEFT].extent_;
+
+      const uint32 index = tick % capacity;
+      entry &e = entries_[index];
+      e.tick_ = tick;
+      for (uint32 side = 0; side < MATCH_SIDE_COUNT; side++) {
+         quantize_position(e.ships_[side], m.ships_[side].entity_.collider_.center_);
+         quantize_position(e.formations_[side], m.invaders_[side].collider_of(0).center_);
+      }
+      valid_[index] = true;
+   }
+
+   bool collider_history::rewind(const match &m, uint32 tick, hit_targets &result) const {
+      const uint32 index = tick % capacity;
+      if (!valid_[index] || entries_[index].tick_ != tick) {
+         return false;
+      }
+
+      // note: the formation moved by the difference of the quantized
+      //       centers, so an unmoved one rewinds onto itself exactly
+      const entry &e = entries_[index];
+      for (uint32 side = 0; side < MATCH_SIDE_COUNT; side++) {
+         result.ships_[side] = collider(dequantize_position(e.ships_[side]), extents_[KIND_SHIP]);
+
+         const invaders &formation = m.invaders_[side];
+         uint16 now[2];
+         quantize_position(now, formation.collider_of(0).center_);
+         const vector2 move = dequantize_position(e.formations_[side]) - dequantize_position(now);
+         for (uint32 invader = 0; invader < invaders::capacity; invader++) {
+            result.invaders_[side][invader] = collider(formation.collider_of(invader).center_ + move, extents_[KIND_INVADER]);
+         }
+      }
+
+      return true;
+   }
+
+   void collider_history::step(match &m, uint32 tick, const input &left, const input &right) {
+      const input *inputs[MATCH_SIDE_COUNT] = { &left, &right };
+      hit_targets targets[MATCH_SIDE_COUNT];
+      const hit_targets *rewound[MATCH_SIDE_COUNT] = {};
+      for (uint32 side = 0; side < MATCH_SIDE_COUNT; side++) {
+         const uint32 depth = inputs[side]->rewind_;
+         if (depth > 0 && rewind(m, tick - depth, targets[side])) {
+            rewound[side] = &targets[side];
+         }
+      }
+
+      m.step(left, right, rewound);
+      record(m, tick);
+   }
+
+   message_snapshot::message_snapshot(const snapshot_ring &baselines)
+      : message_header(MESSAGE_SNAPSHOT)
+      , baselines_(baselines)
+      , baseline_age_(0)
+   {
+   }
+
+   message_snapshot::message_snapshot(const snapshot_ring &baselines, const snapshot &value, uint32 baseline_tick)
+      : message_header(MESSAGE_SNAPSHOT)
+      , baselines_(baselines)
+      , baseline_age_(0)
+      , snapshot_(value)
+   {
+      // note: falls back to the empty snapshot once the baseline aged out
+      if (baselines.find(baseline_tick) && (int32)(value.tick_ - baseline_tick) > 0) {
+         baseline_age_ = value.tick_ - baseline_tick;
+      }
+   }
+} // !uu
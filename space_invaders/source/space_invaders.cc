@@ -2,142 +2,112 @@
 
 #include "space_invaders.h"
 
-#define LOCAL_HOST 127, 0, 0, 1
+#include <stdlib.h>
 
 namespace gamma
 {
-	game_base* create_game(string& caption, video_mode& mode)
+	game_base* create_game(const char* cmd_line, string& caption, video_mode& mode)
 	{
 		caption = "SPACE INVADERS";
 		mode = video_mode(1024, 512);
-		return new uu::space_invaders;
+		return new uu::space_invaders(cmd_line);
 	}
 }
 
 namespace uu
 {
-	namespace
-	{
-		struct contact
-		{
-			entity* a_;
-			entity* b_;
-			vector2 position_;
-		};
+	constexpr int64 fire_rate_ms = 750;
+	constexpr int64 max_send_interval_ms = 100;
+	constexpr uint32 send_budget = 16000;
 
-		void check_collision(bullets& b, invaders& i, dynamic_array<contact>& c)
-		{
-			for (auto& bullet : b.entity_)
-			{
-				if (!bullet.visible_)
-				{
-					continue;
-				}
+	// note: the match server used when the command line names none
+	constexpr const char* default_server_host = "127.0.0.1";
+	constexpr uint16 default_server_port = 32100;
 
-				for (auto& invader : i.entity_)
-				{
-					if (!invader.visible_)
-					{
-						continue;
-					}
-
-					if (collider::overlap(bullet.collider_, invader.collider_))
-					{
-						bullet.visible_ = false;
-						invader.visible_ = false;
-
-						contact cc;
-						cc.a_ = &bullet;
-						cc.b_ = &invader;
-						cc.position_ = invader.collider_.min();
-						c.push_back(cc);
-
-						break;
-					}
-				}
-			}
-		}
+	// note: a lost handshake is resent this often, a response that stays
+	//       unanswered starts over with a request for a fresh cookie
+	constexpr int64 handshake_resend_ms = 100;
+	constexpr int64 handshake_retry_ms = 2000;
 
-		void check_collision(bullets& bu, blocks& bl, dynamic_array<contact>& c)
-		{
-			for (int bullet_index = 0; bullet_index < _countof(bu.entity_); bullet_index++)
-			{
-				entity& bullet = bu.entity_[bullet_index];
-				if (!bullet.visible_)
-				{
-					continue;
-				}
+	// note: a full receive batch plus the datagram being sent
+	constexpr uint32 packet_count = 32;
 
-				for (int block_index = 0; block_index < _countof(bl.entity_); block_index++)
-				{
-					entity& block = bl.entity_[block_index];
-					if (!block.visible_)
-					{
-						continue;
-					}
-
-					if (collider::overlap(bullet.collider_, block.collider_))
-					{
-						bullet.visible_ = false;
-						bl.health_[block_index]--;
-						if (!bl.health_[block_index])
-						{
-							block.visible_ = false;
-						}
-
-						contact cc;
-						cc.a_ = &bullet;
-						cc.b_ = &block;
-						cc.position_ = bullet.collider_.min() + vector2(0.0f, -24.0f * bu.direction_[bullet_index].x_);
-						c.push_back(cc);
-
-						break;
-					}
-				}
-			}
-		}
+	// note: a remote this many frames ahead is caught up with extra ticks
+	constexpr uint32 catch_up_frames = 8;
 
-		void check_collision(bullets& b, spaceship& ship, dynamic_array<contact>& c)
-		{
-			for (auto& bullet : b.entity_)
-			{
-				if (!bullet.visible_)
-				{
-					continue;
-				}
+	// note: the client always plays the left side
+	constexpr match_side local_side = MATCH_SIDE_LEFT;
 
-				if (collider::overlap(bullet.collider_, ship.entity_.collider_))
-				{
-					bullet.visible_ = false;
+	// note: the engine calls update once per match tick
+	static_assert(match::tick_ms == game_base::tick_ms, "The match has to step at the engine tick rate");
 
-					contact cc;
-					cc.a_ = &bullet;
-					cc.b_ = &ship.entity_;
-					cc.position_ = bullet.collider_.min() - vector2(0.0f, 26.0f);
-					c.push_back(cc);
+	// note: F2 appends the counters of the link here once a second
+	constexpr const char* telemetry_path = "telemetry.log";
+	constexpr int64 telemetry_interval_ms = 1000;
 
-					break;
-				}
-			}
-		}
-	} // !anon
-
-	constexpr int64 fire_rate_ms = 750;
-	constexpr int64 send_interval = 100;
-
-	space_invaders::space_invaders()
-		: sprite_sheet_(sprites_)
+	struct network_profile
+	{
+		const char* name_;
+		int64 latency_ms_;
+		int64 jitter_ms_;
+		float loss_;
+		float duplicate_;
+		float reorder_;
+		uint32 bandwidth_;
+	};
+
+	// note: one way figures, the same link is simulated in both directions
+	const network_profile network_profiles[] =
+	{
+		{ "LAN",        0,  0, 0.00f, 0.000f, 0.00f,      0 },
+		{ "BROADBAND", 20,  5, 0.01f, 0.000f, 0.00f, 250000 },
+		{ "WIFI",      30, 30, 0.03f, 0.010f, 0.01f, 125000 },
+		{ "MOBILE",    80, 60, 0.08f, 0.020f, 0.05f,  32000 },
+	};
+
+	space_invaders::space_invaders(const char* cmd_line)
+		: server_host_(default_server_host)
+		, server_port_(default_server_port)
+		, conditioner_(socket_)
+		, network_profile_(0)
+		, sprite_sheet_(sprites_)
 		, state_(GAME_STATE_INIT)
-		, invaders_left_({ 200.0f, 10.0f }, { -1.0f, 1.0f })
-		, invaders_right_({ 1024.0f - 392.0f, 118.0f }, { 1.0f, -1.0f })
-		, ship_left_({ 10.0f, 512.0f * 0.5f - 16.0f }, { 32.0f, 24.0f })
-		, ship_right_({ 1024.0f - 48.0f, 512.0f * 0.5f - 16.0f }, { -32.0f, 24.0f })
-		, blocks_left_({ 1024, 512 })
-		, blocks_right_({ 1024, 512 })
 		, connection_pair_(false, false)
 		, is_host_(false)
-		, send_timer_(send_interval)
+		, input_tick_(0)
+		, handshake_(MESSAGE_HANDSHAKE_REQUEST, 0, 0)
+		, handshake_sent_(0)
+		, handshake_challenged_(0)
+		, handshake_done_(false)
+		, receive_count_(0)
+		, receive_index_(0)
 	{
+		for (auto& tick : sent_input_tick_)
+		{
+			tick = 0;
+		}
+		rate_.configure(match::tick_ms, max_send_interval_ms, send_budget);
+
+		// note: the command line is "[host] [port]" of the match server, a
+		//       missing or unparsable port keeps the default one
+		const string args = cmd_line ? cmd_line : "";
+		const size_t split = args.find(' ');
+		if (split != 0 && !args.empty())
+			server_host_ = args.substr(0, split);
+		if (split != string::npos)
+		{
+			const uint16 port = (uint16)atoi(args.c_str() + split + 1);
+			if (port != 0)
+				server_port_ = port;
+		}
+
+		dispatcher_.set<uu::message_connection_request, &space_invaders::receive_connection_request>(MESSAGE_CONNECTION_REQUEST);
+		dispatcher_.set<uu::message_connection_response, &space_invaders::receive_connection_response>(MESSAGE_CONNECTION_RESPONSE);
+		dispatcher_.set<uu::message_disconnect, &space_invaders::receive_disconnect>(MESSAGE_DISCONNECT);
+		dispatcher_.set<uu::message_input, &space_invaders::receive_input>(MESSAGE_INPUT);
+		dispatcher_.set<uu::message_input_buffer, &space_invaders::receive_input_buffer>(MESSAGE_INPUT_BUFFER);
+		dispatcher_.set<uu::message_ping, &space_invaders::receive_ping>(MESSAGE_PING);
+		dispatcher_.set<uu::message_pong, &space_invaders::receive_pong>(MESSAGE_PONG);
 	}
 
 	space_invaders::~space_invaders()
@@ -153,6 +123,11 @@ namespace uu
 										errcode, network::error::as_string(errcode));
 		}
 
+		if (!packets_.create(packet_count))
+		{
+			return false;
+		}
+
 		if (!sprites_.create_from_file("assets/sprites.png"))
 		{
 			return false;
@@ -181,20 +156,24 @@ namespace uu
 		sprite_sheet_.add(RIGHT_PLAYER, { 26.0f,  94.0f,  -8.0f, 13.0f });
 
 		// note: initialize entities
-		bullets_.reset(sprite_sheet_, sprites_);
-		explosions_.reset(sprite_sheet_, sprites_);
-		invaders_left_.reset(sprite_sheet_, sprites_, true);
-		invaders_right_.reset(sprite_sheet_, sprites_, false);
-		ship_left_.reset(sprite_sheet_, sprites_, true);
-		ship_right_.reset(sprite_sheet_, sprites_, false);
-		blocks_left_.reset(sprite_sheet_, sprites_, LEFT_BASE_DMG0);
-		blocks_right_.reset(sprite_sheet_, sprites_, RIGHT_BASE_DMG0);
+		reset_entities();
 
 		return true;
 	}
 
+	void space_invaders::reset_entities()
+	{
+		rollback_.reset(sprite_sheet_, sprites_);
+		jitter_.reset();
+		interpolation_.reset();
+		accumulator_ = time(0);
+		local_ship_from_ = rollback_.state_.ships_[local_side].entity_.position_;
+	}
+
 	void space_invaders::exit()
 	{
+		release_batch();
+		packets_.destroy();
 		sprites_.destroy();
 		network::shut();
 	}
@@ -203,13 +182,41 @@ namespace uu
 	{
 		if (kb.is_released(KEYCODE_ESCAPE))
 		{
+			if (state_ == GAME_STATE_PLAY)
+			{
+				// note: best effort, we will not be around for the resend
+				uu::message_disconnect message;
+				connection_.send_reliable(message);
+				send_packet();
+			}
 			return false;
 		}
 
+		if (kb.is_pressed(KEYCODE_F1))
+		{
+			set_network_profile((network_profile_ + 1) % countof(network_profiles));
+		}
+
+		if (kb.is_pressed(KEYCODE_F2))
+		{
+			if (telemetry_.is_open())
+				telemetry_.close();
+			else
+				telemetry_.open(telemetry_path, telemetry_interval_ms);
+		}
+
+		const time telemetry_now = time::now();
+		if (telemetry_.is_due(telemetry_now))
+		{
+			telemetry_.write(telemetry_now, "socket", socket_.stats_);
+			telemetry_.write(telemetry_now, "connection", 0, connection_.stats_);
+			telemetry_.flush();
+		}
+
 		if (state_ == GAME_STATE_INIT)
 		{
+			// note: any free local port, the match server learns it from the handshake
 			ip_address local;
-			local.set_port(32100);
 			if (!socket_.open(local))
 			{
 				auto errcode = network::error::get_error();
@@ -217,9 +224,12 @@ namespace uu
 											errcode, network::error::as_string(errcode));
 			}
 
-			//remote_.set_host(LOCAL_HOST);
-			remote_.set_host(192, 168, 1, 120);
-			remote_.set_port(32100);
+			dynamic_array<ip_address> addresses;
+			if (!ip_address::lookup(server_host_, addresses) || addresses.empty())
+				return !system::message_box("Could not resolve %s!", server_host_.c_str());
+
+			remote_ = addresses[0];
+			remote_.set_port(server_port_);
 
 			state_ = GAME_STATE_CONNECTING;
 		}
@@ -234,18 +244,21 @@ namespace uu
 					is_host_ = true;
 			}
 
-			uint8 array[1400];
-			gamma::byte_stream stream(sizeof(array), array);
-			if (socket_.recv_from(remote_, stream))
+			// note: the match request travels on the reliable channel, keep
+			//       sending so it is resent until the remote acks it. nothing
+			//       goes out on the connection before the server has a session
+			receive_packets();
+			const time now = time::now();
+			if (!handshake_done_)
 			{
-				if (receive_connection_request(stream))
-				{
-					send_connection_response();
-					connection_pair_.second = true;
-				}
-
-				if (receive_connection_response(stream))
-					connection_pair_.first = true;
+				if (now.tick_ - handshake_sent_.tick_ >= handshake_resend_ms)
+					send_handshake(now);
+			}
+			else
+			{
+				rate_.update(now, connection_, clock_);
+				if (rate_.should_send(now))
+					send_packet();
 			}
 
 			if (connection_pair_.first && connection_pair_.second)
@@ -254,289 +267,402 @@ namespace uu
 
 		else if (state_ == GAME_STATE_PLAY)
 		{
-
-			send_timer_ = send_timer_ - dt;
-			if (send_timer_.as_milliseconds() < 0.f)
+			receive_packets();
+			if (state_ != GAME_STATE_PLAY)
 			{
-				send_timer_ = time(send_interval);
-				// send
-				uu::message_input_buffer message_input_buffer(input_buffer_);
-				send_input_buffer(message_input_buffer);
-				input_buffer_.clear();
+				return true;
 			}
 
-			uu::message_input_buffer OUT_message_input_buffer;
-			while (receive_input_buffer(OUT_message_input_buffer))
+			// note: stalled on the remote, holding inputs back only adds delay
+			if (!rollback_.can_advance())
 			{
-				for (int i = 0; i < OUT_message_input_buffer.size_; ++i)
-				{
-					input input = OUT_message_input_buffer.input_buffer_[i];
-
-					if (input.dt_ == 0)
-						break;
-
-					ship_right_.direction_ = {};
-					if (input.has_up())
-					{
-						ship_right_.direction_.y_ -= 1.0f;
-					}
-					if (input.has_down())
-					{
-						ship_right_.direction_.y_ += 1.0f;
-					}
-					if (input.has_space())
-					{
-						vector2 pos = ship_right_.entity_.position_ + ship_right_.offset_;
-						bullets_.spawn(pos, { -1.0f, 0.0f });
-					}
-
-					time buffer_dt(input.dt_);
-					bullets_.update(buffer_dt);
-					invaders_right_.update(buffer_dt);
-					ship_right_.update(buffer_dt);
-					blocks_right_.update(sprite_sheet_);
-				}
+				jitter_.flush();
+				release_remote_inputs();
 			}
 
-			//uu::message_input OUT_input_message;
-			//if (receive_input(OUT_input_message))
-			//{
-			   // // note: remote player
-			   // ship_right_.direction_ = {};
-			   // if (OUT_input_message.has_up())
-			   // {
-				  //  ship_right_.direction_.y_ -= 1.0f;
-			   // }
-			   // if (OUT_input_message.has_down())
-			   // {
-				  //  ship_right_.direction_.y_ += 1.0f;
-			   // }
-			   // if (OUT_input_message.has_space())
-			   // {
-				  //  vector2 pos = ship_right_.entity_.position_ + ship_right_.offset_;
-				  //  bullets_.spawn(pos, { -1.0f, 0.0f });
-			   // }
-			//}
-
-
-			bool up = false;
-			bool down = false;
-			bool space = false;
-			// note: local player
-			ship_left_.direction_ = {};
-			if (kb.is_down(KEYCODE_W))
+			// note: late remote inputs rewrite the frames predicted so far
+			rollback_.resimulate();
+			local_ship_from_ = rollback_.state_.ships_[local_side].entity_.position_;
+
+			// note: the match runs on fixed ticks, the local player is sampled
+			//       once per tick and shows up on screen without waiting for
+			//       the remote
+			const time tick(match::tick_ms);
+			accumulator_ = accumulator_ + dt;
+			while ((accumulator_.tick_ >= match::tick_ms || rollback_.remote_lead() > catch_up_frames) &&
+				   rollback_.can_advance())
 			{
-				ship_left_.direction_.y_ -= 1.0f;
-				up = true;
-			}
-			if (kb.is_down(KEYCODE_S))
-			{
-				ship_left_.direction_.y_ += 1.0f;
-				down = true;
-			}
+				if (accumulator_.tick_ >= match::tick_ms)
+					accumulator_ = accumulator_ - tick;
 
-			firetimer_ = firetimer_ - dt;
-			if (kb.is_down(KEYCODE_SPACE) && firetimer_.as_seconds() < 0.0f)
-			{
-				firetimer_ = time(fire_rate_ms);
-				vector2 pos = ship_left_.entity_.position_ + ship_left_.offset_;
-				bullets_.spawn(pos, { 1.0f, 0.0f });
-
-				space = true;
-			}
-			bullets_.update(dt);
+				bool up = kb.is_down(KEYCODE_W);
+				bool down = kb.is_down(KEYCODE_S);
+				bool space = false;
 
-			input_buffer_.push_back(input(up, down, space, dt.tick_));
+				firetimer_ = firetimer_ - tick;
+				if (kb.is_down(KEYCODE_SPACE) && firetimer_.as_seconds() < 0.0f)
+				{
+					firetimer_ = time(fire_rate_ms);
+					space = true;
+				}
 
-			message_input inputMessage(up, down, space);
-			send_input(inputMessage);
+				// note: remote inputs come out of the jitter buffer at the tick rate
+				jitter_.tick();
+				release_remote_inputs();
+				rollback_.resimulate();
+
+				// note: the server and the remote judge this tick's shots by
+				//       the same rewind, it travels with the input
+				input local(up, down, space, (uint64)match::tick_ms);
+				local.rewind_ = (uint8)rollback_.rewind();
+				input_buffer_.push_back(local);
+				local_ship_from_ = rollback_.state_.ships_[local_side].entity_.position_;
+				rollback_.advance(local);
+			}
 
-			invaders_left_.update(dt);
-			ship_left_.update(dt);
-			blocks_left_.update(sprite_sheet_);
+			// note: stalled on the remote, do not bank the time spent waiting
+			if (!rollback_.can_advance() && accumulator_.tick_ > match::tick_ms)
+				accumulator_ = tick;
 
-			// note: remote ...
-			//invaders_right_.update(dt);
-			//ship_right_.update(dt);
-			//blocks_right_.update(sprite_sheet_);
+			// note: the remote side is drawn from these samples, behind by
+			//       as much as the remote inputs arrive unevenly
+			const time now = time::now();
+			interpolation_.set_jitter(jitter_.jitter_ms_);
+			interpolation_.push(now, rollback_.state_);
 
-			// note: collision
-			dynamic_array<contact> contacts;
-			check_collision(bullets_, blocks_left_, contacts);
-			check_collision(bullets_, blocks_right_, contacts);
-			check_collision(bullets_, invaders_left_, contacts);
-			check_collision(bullets_, invaders_right_, contacts);
-			for (auto& c : contacts)
+			// note: the rate controller decides how often a datagram goes out,
+			//       each one resends everything the remote has not acked yet
+			rate_.update(now, connection_, clock_);
+			if (rate_.should_send(now))
 			{
-				explosions_.spawn(c.position_);
+				uu::message_input_buffer message_input_buffer(input_tick_, input_buffer_);
+				if (send_input_buffer(message_input_buffer))
+				{
+					const uint32 end = message_input_buffer.base_tick_ + (uint32)message_input_buffer.input_buffer_.size();
+					sent_input_tick_[connection_.next_sequence() % connection::packet_window] = end;
+				}
+				send_packet();
 			}
-			contacts.clear();
 
-			check_collision(bullets_, ship_left_, contacts);
-			check_collision(bullets_, ship_right_, contacts);
-			for (auto& c : contacts)
+			uint16 sequence = 0;
+			while (connection_.poll_ack(sequence))
 			{
-				explosions_.spawn(c.position_);
+				acknowledge_inputs(sent_input_tick_[sequence % connection::packet_window]);
 			}
-			contacts.clear();
-
-			explosions_.update(dt);
 		}
 
 		return true;
 	}
 
-	bool space_invaders::send_input(uu::message_input& inputMessage)
+	void space_invaders::acknowledge_inputs(uint32 end)
 	{
-		uint8 array[1400] = {};
-		gamma::byte_stream stream(sizeof(array), array);
-		gamma::byte_stream_writer writer(stream);
-		if (!inputMessage.serialize(writer))
-		{
-			return false;
-		}
-		if (!socket_.send_to(remote_, stream))
-		{
-			return false;
-		}
-		return true;
+		// note: the remote has every input before end, stop resending them
+		if ((int32)(end - input_tick_) <= 0)
+			return;
+
+		const uint32 count = end - input_tick_;
+		if (count >= input_buffer_.size())
+			input_buffer_.clear();
+		else
+			input_buffer_.erase(input_buffer_.begin(), input_buffer_.begin() + count);
+		input_tick_ = end;
 	}
 
-	bool space_invaders::receive_input(uu::message_input& inputMessage)
+	void space_invaders::set_network_profile(uint32 index)
 	{
-		uint8 array[1400] = {};
-		gamma::byte_stream stream(sizeof(array), array);
-		if (!socket_.recv_from(remote_, stream))
-			return false;
+		const network_profile& profile = network_profiles[index];
+		const network_conditions conditions(profile.latency_ms_, profile.jitter_ms_, profile.loss_,
+											profile.duplicate_, profile.reorder_, profile.bandwidth_);
+		conditioner_.set_conditions(conditions, conditions);
+		network_profile_ = index;
+	}
 
-		gamma::byte_stream_reader reader(stream);
-		inputMessage.serialize(reader);
+	bool space_invaders::receive_input(space_invaders&, uu::message_input& inputMessage)
+	{
 		return inputMessage.is_valid();
 	}
 
 	bool space_invaders::send_input_buffer(uu::message_input_buffer& input_buffer_message)
 	{
-		uint8 array[1400] = {};
-		gamma::byte_stream stream(sizeof(array), array);
-		gamma::byte_stream_writer writer(stream);
-		if (!input_buffer_message.serialize(writer))
+		return connection_.send_unreliable(input_buffer_message);
+	}
+
+	bool space_invaders::receive_input_buffer(space_invaders& game, uu::message_input_buffer& input_buffer_message)
+	{
+		// note: kept even before the match has started on this side, the
+		//       packet carrying them is acked and the server never resends
+		//       those ticks. ticks already released are skipped by push
+		jitter_buffer& jitter = game.jitter_;
+		const std::vector<input>& entries = input_buffer_message.input_buffer_;
+		for (uint32 i = 0; i < (uint32)entries.size(); ++i)
 		{
-			return false;
+			// note: the jitter buffer skips entries this side already has
+			const uint32 tick = input_buffer_message.base_tick_ + i;
+			if (!jitter.push(tick, entries[i]))
+				break;
 		}
-		if (!socket_.send_to(remote_, stream))
+		jitter.arrived(time::now());
+
+		return true;
+	}
+
+	void space_invaders::release_remote_inputs()
+	{
+		uint32 tick = 0;
+		input value;
+		while (jitter_.pop(tick, value))
 		{
-			return false;
+			rollback_.add_remote_input(tick, value);
 		}
-		return true;
 	}
 
-	bool space_invaders::receive_input_buffer(uu::message_input_buffer& input_buffer_message)
+	bool space_invaders::send_packet()
 	{
-		uint8 array[1400] = {};
-		gamma::byte_stream stream(sizeof(array), array);
-		if (!socket_.recv_from(remote_, stream))
+		const time now = time::now();
+		send_clock_messages(connection_, clock_, now);
+
+		gamma::byte_stream stream;
+		if (!packets_.acquire(stream))
 			return false;
 
-		gamma::byte_stream_reader reader(stream);
-		input_buffer_message.serialize(reader);
-		return true;
+		if (!connection_.write_packet(now, stream))
+		{
+			packets_.release(stream);
+			return false;
+		}
+		rate_.on_sent(now, stream.length());
+
+		// note: packets without an input buffer acknowledge nothing new
+		sent_input_tick_[connection_.next_sequence() % connection::packet_window] = input_tick_;
+		const bool result = conditioner_.send_to(remote_, stream);
+		packets_.release(stream);
+
+		return result;
 	}
 
-	void space_invaders::render(render_system& rs)
+	void space_invaders::receive_packets()
 	{
-		rs.clear(0xff440044);
-		if (state_ == GAME_STATE_INIT)
-		{
-			rs.draw_text(10, 10, 0xffffffff, 3, "INIT STATE");
-		}
-		else if (state_ == GAME_STATE_CONNECTING)
+		const time now = time::now();
+
+		gamma::byte_stream* packet = nullptr;
+		while (receive_packet(packet))
 		{
-			rs.draw_text(10, 10, 0xffffffff, 3, "WAITING FOR OPPONENT");
+			// note: challenges may still trail in after the session is up
+			if (receive_handshake(*packet, now))
+				continue;
+
+			if (!connection_.read_packet(now, *packet))
+				continue;
+			handshake_done_ = true;
+
+			gamma::byte_stream message;
+			while (connection_.receive_reliable(message))
+			{
+				receive_messages(message);
+			}
+
+			receive_messages(connection_.unreliable_payload());
 		}
-		else if (state_ == GAME_STATE_PLAY)
+	}
+
+	bool space_invaders::send_handshake(const time& now)
+	{
+		if (handshake_.type_ == MESSAGE_HANDSHAKE_RESPONSE &&
+			now.tick_ - handshake_challenged_.tick_ >= handshake_retry_ms)
 		{
-			invaders_left_.render(rs);
-			invaders_right_.render(rs);
-			bullets_.render(rs);
-			explosions_.render(rs);
-			ship_left_.render(rs);
-			ship_right_.render(rs);
-			blocks_left_.render(rs);
-			blocks_right_.render(rs);
+			handshake_ = message_handshake(MESSAGE_HANDSHAKE_REQUEST, 0, 0);
 		}
+
+		gamma::byte_stream stream;
+		if (!packets_.acquire(stream))
+			return false;
+
+		handshake_sent_ = now;
+		const bool result = write_handshake(stream, handshake_) && conditioner_.send_to(remote_, stream);
+		packets_.release(stream);
+
+		return result;
 	}
-	bool space_invaders::send_connection_request()
+
+	bool space_invaders::receive_handshake(gamma::byte_stream& stream, const time& now)
 	{
-		uint8 array[1400] = {};
-		gamma::byte_stream stream(sizeof(array), array);
-		gamma::byte_stream_writer writer(stream);
-		uu::message_connection_request message;
-		if (!message.serialize(writer))
-		{
+		uu::message_handshake message;
+		if (!read_handshake(stream, message))
 			return false;
-		}
 
-		if (!socket_.send_to(remote_, stream))
+		// note: answer right away, the cookie is only good for a while
+		if (!handshake_done_ && message.type_ == MESSAGE_HANDSHAKE_CHALLENGE)
 		{
-			return false;
+			handshake_ = message_handshake(MESSAGE_HANDSHAKE_RESPONSE, message.issued_, message.cookie_);
+			handshake_challenged_ = now;
+			send_handshake(now);
 		}
 
 		return true;
 	}
-	bool space_invaders::send_connection_response()
+
+	void space_invaders::receive_messages(gamma::byte_stream& stream)
 	{
-		uint8 array[1400] = {};
-		gamma::byte_stream stream(sizeof(array), array);
-		gamma::byte_stream_writer writer(stream);
-		uu::message_connection_response message;
-		message.random_ = 666666;
-		if (!message.serialize(writer))
+		// note: a stream carries every message the remote queued
+		//       during one tick, the dispatcher walks all of them
+		dispatcher_.dispatch(*this, stream);
+	}
+
+	bool space_invaders::receive_disconnect(space_invaders& game, uu::message_disconnect&)
+	{
+		game.disconnect();
+		return false;
+	}
+
+	bool space_invaders::receive_ping(space_invaders& game, uu::message_ping& message)
+	{
+		uu::receive_ping(game.clock_, message, time::now());
+		return true;
+	}
+
+	bool space_invaders::receive_pong(space_invaders& game, uu::message_pong& message)
+	{
+		uu::receive_pong(game.clock_, message, time::now());
+		return true;
+	}
+
+	void space_invaders::disconnect()
+	{
+		state_ = GAME_STATE_CONNECTING;
+		connection_pair_ = std::make_pair(false, false);
+		is_host_ = false;
+		connection_.reset();
+		handshake_ = message_handshake(MESSAGE_HANDSHAKE_REQUEST, 0, 0);
+		handshake_done_ = false;
+		clock_.reset();
+		rate_.reset();
+		for (auto& tick : sent_input_tick_)
 		{
-			return false;
+			tick = 0;
 		}
+		input_buffer_.clear();
+		input_tick_ = 0;
+		reset_entities();
+	}
 
-		if (!socket_.send_to(remote_, stream))
+	bool space_invaders::receive_packet(gamma::byte_stream*& stream)
+	{
+		// note: only the match server may talk to us, drop everything else
+		while (receive_index_ < receive_count_ || receive_batch())
 		{
-			return false;
+			const uint32 index = receive_index_++;
+			if (receive_addresses_[index] == remote_)
+			{
+				stream = &receive_streams_[index];
+				return true;
+			}
 		}
 
-		return true;
+		return false;
 	}
 
-	bool space_invaders::receive_connection_request(gamma::byte_stream& stream)
+	bool space_invaders::receive_batch()
 	{
-		gamma::byte_stream_reader reader(stream);
+		// note: every stream of the previous batch has been handed out and
+		//       read by now, its buffers go back before new ones are taken
+		release_batch();
 
-		uu::message_connection_request req_msg;
-		if (!req_msg.serialize(reader))
+		uint32 acquired = 0;
+		while (acquired < receive_batch_size && packets_.acquire(receive_streams_[acquired]))
 		{
-			return false;
+			acquired++;
 		}
-		if (!req_msg.is_valid())
+
+		const bool result = acquired > 0 &&
+			conditioner_.recv_batch(acquired, receive_addresses_, receive_streams_, receive_count_);
+		for (uint32 index = receive_count_; index < acquired; index++)
 		{
-			return false;
+			packets_.release(receive_streams_[index]);
 		}
-		return true;
+
+		return result;
 	}
 
-	bool space_invaders::receive_connection_response(gamma::byte_stream& stream)
+	void space_invaders::release_batch()
 	{
-		gamma::byte_stream_reader reader(stream);
+		for (uint32 index = 0; index < receive_count_; index++)
+		{
+			packets_.release(receive_streams_[index]);
+		}
+		receive_index_ = 0;
+		receive_count_ = 0;
+	}
 
-		uu::message_connection_response response;
-		if (!response.serialize(reader))
+	void space_invaders::render(render_system& rs, float alpha)
+	{
+		rs.clear(0xff440044);
+		if (state_ == GAME_STATE_INIT)
 		{
-			return false;
+			rs.draw_text(10, 10, 0xffffffff, 3, "INIT STATE");
+		}
+		else if (state_ == GAME_STATE_CONNECTING)
+		{
+			rs.draw_text(10, 10, 0xffffffff, 3, "WAITING FOR OPPONENT");
+		}
+		else if (state_ == GAME_STATE_PLAY)
+		{
+			// note: the remote side is placed by the interpolation buffer, the
+			//       local ship is drawn between its last two ticks
+			match view = rollback_.state_;
+			interpolation_.apply(time::now(), view);
+
+			entity& ship = view.ships_[local_side].entity_;
+			ship.sprite_.set_position(local_ship_from_ + (ship.position_ - local_ship_from_) * alpha);
+			view.render(rs);
 		}
-		if (response.random_ == 666666)
+
+		rs.draw_text(10, 460, 0xffffffff, 1, "INTERPOLATION %d MS  EXTRAPOLATED %d",
+					 (int)interpolation_.delay_ms_, (int)interpolation_.underruns_);
+		rs.draw_text(10, 470, 0xffffffff, 1, "INPUT BUFFER %d/%d  UNDERRUN %d  OVERFLOW %d",
+					 (int)jitter_.depth(), (int)jitter_.target_depth_, (int)jitter_.underruns_, (int)jitter_.overflows_);
+		rs.draw_text(10, 480, 0xffffffff, 1, "SEND %d HZ  %d B/S  LOSS %d PCT",
+					 (int)rate_.packet_rate_, (int)rate_.byte_rate_, (int)(rate_.loss_ * 100.0f));
+		rs.draw_text(10, 490, 0xffffffff, 1, "NETWORK %s (F1)  TELEMETRY %s (F2)",
+					 network_profiles[network_profile_].name_, telemetry_.is_open() ? "ON" : "OFF");
+		if (clock_.is_valid())
 		{
-			return true;
+			rs.draw_text(10, 500, 0xffffffff, 1, "RTT %d MS  JITTER %d MS",
+						 (int)clock_.rtt_ms(), (int)clock_.jitter_ms());
 		}
+	}
+	bool space_invaders::send_connection_request()
+	{
+		uu::message_connection_request message;
+		return connection_.send_reliable(message);
+	}
 
-		return false;
+	bool space_invaders::send_connection_response()
+	{
+		uu::message_connection_response message;
+		message.random_ = 666666;
+		return connection_.send_reliable(message);
 	}
 
+	bool space_invaders::receive_connection_request(space_invaders& game, uu::message_connection_request& message)
+	{
+		if (!message.is_valid())
+		{
+			return false;
+		}
 
+		game.send_connection_response();
+		game.connection_pair_.second = true;
+		return true;
+	}
 
+	bool space_invaders::receive_connection_response(space_invaders& game, uu::message_connection_response& message)
+	{
+		if (message.random_ != 666666)
+		{
+			return false;
+		}
 
+		game.connection_pair_.first = true;
+		return true;
+	}
 } // !uu